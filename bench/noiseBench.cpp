@@ -0,0 +1,302 @@
+#include "interfaces/NoiseGenerator"
+#include "../test/TestHelpers.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Headless benchmark for the noise generators. Prints a table and optionally writes every result as JSON:
+//      noiseBench [--quick] [--repeats N] [--json results.json]
+
+struct Config {
+    std::string name;
+    int width, length, height;
+    int scaleX, scaleY, scaleZ;
+    int numOctaves;
+    std::string distribution;
+    int numThreads;
+    // Maps generated per call.
+    int numMaps = 1;
+};
+
+struct Result {
+    Config config;
+    double minMs, medianMs, meanMs, stddevMs;
+    double nsPerVoxel, gigabytesPerSecond;
+    double allocationsPerCall;
+};
+
+// Bumped whenever the fields of the JSON output change, so scripts comparing runs can tell formats apart.
+constexpr int JSONVersion = 1;
+
+struct Options {
+    int warmup = 2;
+    int repeats = 7;
+    bool quick = false;
+    std::string jsonPath;
+};
+
+// Time repeated calls to func after a warm-up and summarize them.
+template <typename Function>
+Result measure(const Config& config, const Options& options, Function&& func) {
+    for (int i = 0; i < options.warmup; ++i) {
+        func();
+    }
+    std::vector<double> times;
+    times.reserve(options.repeats);
+    const long allocationsBefore = numHeapAllocations;
+    for (int i = 0; i < options.repeats; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        func();
+        auto end = std::chrono::steady_clock::now();
+        times.emplace_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    const long allocations = numHeapAllocations - allocationsBefore;
+    std::sort(times.begin(), times.end());
+
+    Result result{};
+    result.config = config;
+    result.minMs = times.front();
+    result.medianMs = times[times.size() / 2];
+    double sum = 0, sumSquares = 0;
+    for (double time : times) {
+        sum += time;
+        sumSquares += time * time;
+    }
+    result.meanMs = sum / times.size();
+    result.stddevMs = std::sqrt(std::max(0.0, sumSquares / times.size() - result.meanMs * result.meanMs));
+    const double numVoxels = (double) config.width * config.length * config.height * config.numMaps;
+    result.nsPerVoxel = result.medianMs * 1e6 / numVoxels;
+    result.gigabytesPerSecond = numVoxels * sizeof(float) / (result.medianMs * 1e6);
+    result.allocationsPerCall = (double) allocations / options.repeats;
+    return result;
+}
+
+Result benchmarkEngine(const Config& config, const Options& options) {
+    const Stealth::Noise::NoiseEngine engine{config.width, config.length, config.height, config.scaleX,
+        config.scaleY, config.scaleZ, config.numOctaves};
+    Stealth::Noise::NoiseWorkspace workspace{};
+    std::vector<float> noise(engine.size());
+    long seed = 0;
+    if (config.distribution == "normal") {
+        return measure(config, options, [&] {
+            engine.generateOctaves(noise, workspace, std::normal_distribution{0.5f, 0.3f}, seed++, config.numThreads);
+        });
+    }
+    return measure(config, options, [&] {
+        engine.generateOctaves(noise, workspace, Stealth::Noise::DefaultDistribution{0.f, 1.f}, seed++,
+            config.numThreads);
+    });
+}
+
+// Several seeds of one shape, in one batched call or in one call per seed.
+template <bool batched>
+Result benchmarkBatch(const Config& config, const Options& options) {
+    const Stealth::Noise::NoiseEngine engine{config.width, config.length, config.height, config.scaleX,
+        config.scaleY, config.scaleZ, config.numOctaves};
+    Stealth::Noise::NoiseWorkspace workspace{};
+    std::vector<std::vector<float>> noise(config.numMaps, std::vector<float>(engine.size()));
+    std::vector<long> seeds(config.numMaps);
+    long seed = 0;
+    return measure(config, options, [&] {
+        for (long& mapSeed : seeds) {
+            mapSeed = seed++;
+        }
+        if constexpr (batched) {
+            engine.generateOctavesBatch(noise.data(), seeds.data(), config.numMaps, workspace,
+                std::normal_distribution{0.5f, 0.3f}, config.numThreads);
+        } else {
+            for (int map = 0; map < config.numMaps; ++map) {
+                engine.generateOctaves(noise[map], workspace, std::normal_distribution{0.5f, 0.3f}, seeds[map],
+                    config.numThreads);
+            }
+        }
+    });
+}
+
+// Central differences of a finished map, one-sided at its edges. gradientZ is only written for 3D maps.
+void finiteDifferences(const std::vector<float>& noise, std::vector<float>& gradientX, std::vector<float>& gradientY,
+    std::vector<float>& gradientZ, int width, int length, int height) {
+    const auto difference = [&](std::vector<float>& gradient, int index, int coordinate, int size, int stride) {
+        const int before = (coordinate > 0) ? stride : 0;
+        const int after = (coordinate < size - 1) ? stride : 0;
+        gradient[index] = (noise[index + after] - noise[index - before]) / std::max(1, (before + after) / stride);
+    };
+    for (int z = 0, index = 0; z < height; ++z) {
+        for (int y = 0; y < length; ++y) {
+            for (int x = 0; x < width; ++x, ++index) {
+                difference(gradientX, index, x, width, 1);
+                difference(gradientY, index, y, length, width);
+                if (height > 1) {
+                    difference(gradientZ, index, z, height, width * length);
+                }
+            }
+        }
+    }
+}
+
+// A map and its gradient, from generateOctavesGradient or from generateOctaves followed by finite differences.
+template <bool analytic>
+Result benchmarkGradient(const Config& config, const Options& options) {
+    const Stealth::Noise::NoiseEngine engine{config.width, config.length, config.height, config.scaleX,
+        config.scaleY, config.scaleZ, config.numOctaves};
+    Stealth::Noise::NoiseWorkspace workspace{};
+    std::vector<float> noise(engine.size()), gradientX(engine.size()), gradientY(engine.size()),
+        gradientZ(engine.size());
+    long seed = 0;
+    return measure(config, options, [&] {
+        if constexpr (analytic) {
+            if (config.height == 1) {
+                engine.generateOctavesGradient(noise, gradientX, gradientY, workspace,
+                    std::normal_distribution{0.5f, 0.3f}, seed++, config.numThreads);
+            } else {
+                engine.generateOctavesGradient(noise, gradientX, gradientY, gradientZ, workspace,
+                    std::normal_distribution{0.5f, 0.3f}, seed++, config.numThreads);
+            }
+        } else {
+            engine.generateOctaves(noise, workspace, std::normal_distribution{0.5f, 0.3f}, seed++,
+                config.numThreads);
+            finiteDifferences(noise, gradientX, gradientY, gradientZ, config.width, config.length, config.height);
+        }
+    });
+}
+
+// The template paths for the shape used by test/noiseTest.cpp.
+template <bool fused>
+Result benchmarkTemplate(const Config& config, const Options& options) {
+    constexpr int WIDTH = 500, LENGTH = 500, HEIGHT = 96;
+    static Stealth::Tensor::Tensor3F<WIDTH, LENGTH, HEIGHT> noise{};
+    long seed = 0;
+    return measure(config, options, [&] {
+        if constexpr (fused) {
+            Stealth::Noise::generateOctavesFused<WIDTH, LENGTH, HEIGHT, WIDTH, LENGTH, HEIGHT, 8>(noise,
+                std::normal_distribution{0.5f, 0.3f}, seed++, 0.5f, config.numThreads);
+        } else {
+            Stealth::Noise::generateOctaves<WIDTH, LENGTH, HEIGHT, WIDTH, LENGTH, HEIGHT, 8>(noise,
+                std::normal_distribution{0.5f, 0.3f}, seed++, 0.5f, config.numThreads);
+        }
+    });
+}
+
+void printResult(const Result& result) {
+    const Config& config = result.config;
+    std::cout << config.name << " " << config.width << "x" << config.length << "x" << config.height
+        << " scale " << config.scaleX << "x" << config.scaleY << "x" << config.scaleZ
+        << " octaves " << config.numOctaves << " " << config.distribution << " threads " << config.numThreads
+        << " maps " << config.numMaps << ": median " << result.medianMs << " ms (min " << result.minMs
+        << ", stddev " << result.stddevMs << "), " << result.nsPerVoxel << " ns/voxel, " << result.gigabytesPerSecond
+        << " GB/s, " << result.allocationsPerCall << " allocations/call" << std::endl;
+}
+
+std::string toJSON(const std::vector<Result>& results) {
+    std::ostringstream json;
+    json << "{\n  \"schema\": \"noiseBench\",\n  \"version\": " << JSONVersion << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& result = results[i];
+        const Config& config = result.config;
+        json << "    {\"name\": \"" << config.name << "\", \"width\": " << config.width << ", \"length\": "
+            << config.length << ", \"height\": " << config.height << ", \"scaleX\": " << config.scaleX
+            << ", \"scaleY\": " << config.scaleY << ", \"scaleZ\": " << config.scaleZ << ", \"octaves\": "
+            << config.numOctaves << ", \"distribution\": \"" << config.distribution << "\", \"threads\": "
+            << config.numThreads << ", \"maps\": " << config.numMaps << ", \"minMs\": " << result.minMs
+            << ", \"medianMs\": " << result.medianMs << ", \"meanMs\": " << result.meanMs << ", \"stddevMs\": "
+            << result.stddevMs << ", \"nsPerVoxel\": " << result.nsPerVoxel << ", \"gigabytesPerSecond\": "
+            << result.gigabytesPerSecond
+            << ", \"allocationsPerCall\": " << result.allocationsPerCall << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    json << "  ]\n}\n";
+    return json.str();
+}
+
+int main(int argc, char* argv[]) {
+    Options options{};
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--quick") == 0) {
+            options.quick = true;
+            options.warmup = 1;
+            options.repeats = 3;
+        } else if (std::strcmp(argv[i], "--repeats") == 0 && i + 1 < argc) {
+            options.repeats = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            options.jsonPath = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--quick] [--repeats N] [--json results.json]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<int> threadCounts{1};
+    const int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    if (hardwareThreads > 1) {
+        threadCounts.emplace_back(hardwareThreads);
+    }
+
+    struct Shape {
+        const char* name;
+        int width, length, height, scaleX, scaleY, scaleZ;
+    };
+    std::vector<Shape> shapes{
+        {"engine1D", 1 << 20, 1, 1, 256, 1, 1},
+        {"engine2D", 2048, 2048, 1, 256, 256, 1},
+        {"engine3D", 500, 500, 96, 500, 500, 96},
+        {"engine3D", 256, 256, 256, 64, 64, 64},
+    };
+    const std::vector<int> octaveCounts = options.quick ? std::vector<int>{8} : std::vector<int>{1, 4, 8};
+
+    std::vector<Result> results;
+    for (const Shape& shape : shapes) {
+        for (int numOctaves : octaveCounts) {
+            for (const char* distribution : {"uniform", "normal"}) {
+                for (int numThreads : threadCounts) {
+                    const Config config{shape.name, shape.width, shape.length, shape.height, shape.scaleX,
+                        shape.scaleY, shape.scaleZ, numOctaves, distribution, numThreads};
+                    results.emplace_back(benchmarkEngine(config, options));
+                    printResult(results.back());
+                }
+            }
+        }
+    }
+    for (const Shape& shape : {shapes[1], shapes[2]}) {
+        for (int numThreads : threadCounts) {
+            results.emplace_back(benchmarkBatch<false>({"separateSeeds", shape.width, shape.length, shape.height,
+                shape.scaleX, shape.scaleY, shape.scaleZ, 8, "normal", numThreads, 4}, options));
+            printResult(results.back());
+            results.emplace_back(benchmarkBatch<true>({"batchedSeeds", shape.width, shape.length, shape.height,
+                shape.scaleX, shape.scaleY, shape.scaleZ, 8, "normal", numThreads, 4}, options));
+            printResult(results.back());
+        }
+    }
+    // Gradients computed with the map against finite differences over the finished map, single threaded like the
+    // difference pass. Each octave adds to the analytic cost, while the difference pass costs the same for any count.
+    for (const Shape& shape : {shapes[1], shapes[3]}) {
+        for (int numOctaves : octaveCounts) {
+            results.emplace_back(benchmarkGradient<false>({"finiteDifferences", shape.width, shape.length,
+                shape.height, shape.scaleX, shape.scaleY, shape.scaleZ, numOctaves, "normal", 1}, options));
+            printResult(results.back());
+            results.emplace_back(benchmarkGradient<true>({"analyticGradient", shape.width, shape.length,
+                shape.height, shape.scaleX, shape.scaleY, shape.scaleZ, numOctaves, "normal", 1}, options));
+            printResult(results.back());
+        }
+    }
+    for (int numThreads : threadCounts) {
+        results.emplace_back(benchmarkTemplate<false>({"generateOctaves", 500, 500, 96, 500, 500, 96, 8, "normal",
+            numThreads}, options));
+        printResult(results.back());
+        results.emplace_back(benchmarkTemplate<true>({"generateOctavesFused", 500, 500, 96, 500, 500, 96, 8,
+            "normal", numThreads}, options));
+        printResult(results.back());
+    }
+
+    if (!options.jsonPath.empty()) {
+        std::ofstream jsonFile{options.jsonPath};
+        jsonFile << toJSON(results);
+    }
+}
@@ -7,6 +7,7 @@ import os
 
 cppstdlib = sbuildr.Library("stdc++")
 libm = sbuildr.Library("m")
+pthread = sbuildr.Library("pthread")
 sfml_libs = list(map(sbuildr.Library, ["sfml-graphics", "sfml-window", "sfml-system"]))
 
 project = sbuildr.Project()
@@ -18,6 +19,10 @@ color = sbuildr.dependencies.Dependency(
     fetchers.GitFetcher("https://github.com/pmarathe25/Color"), builders.SBuildrBuilder()
 )
 
+# Also build everything for the build machine's full instruction set, so that the AVX2 and FMA code generation
+# is tested alongside the default profiles on machines that have them.
+project.profile(name="native", flags=sbuildr.BuildFlags().O(3).std(17).march("native").fpic())
+
 project.interfaces(
     filter(os.path.isfile, glob.glob(os.path.join("include", "**", "*"), recursive=True)), depends=[tensor3]
 )
@@ -26,7 +31,15 @@ for source in glob.iglob(os.path.join("test", "*.cpp"), recursive=True):
     project.test(
         os.path.splitext(os.path.basename(source))[0],
         sources=[source],
-        libs=[color.library("color")] + sfml_libs + [libm, cppstdlib],
+        libs=[color.library("color")] + sfml_libs + [libm, pthread, cppstdlib],
+    )
+
+# Benchmarks are headless, so they do not need SFML.
+for source in glob.iglob(os.path.join("bench", "*.cpp"), recursive=True):
+    project.executable(
+        os.path.splitext(os.path.basename(source))[0],
+        sources=[source],
+        libs=[libm, pthread, cppstdlib],
     )
 
 project.export()
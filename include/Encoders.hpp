@@ -0,0 +1,161 @@
+#ifndef NOISE_ENCODERS_H
+#define NOISE_ENCODERS_H
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <vector>
+#if defined(__AVX2__) || defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+// Encoders turn normalized noise values into the elements of a compact output map. NoiseEngine::generateOctaves
+// and generateChunk call an encoder on every block while it is still in cache, so the float map never exists.
+// An encoder provides a value_type and an operator()(const float* values, int count, value_type* output).
+namespace Stealth::Noise {
+    // One 8-bit per channel color, laid out the way textures expect it.
+    struct RGBA {
+        uint8_t r, g, b, a;
+    };
+
+    // Maps [low, high] linearly onto the full range of an unsigned integer type of up to 16 bits. Values outside are
+    // clamped, and NaN maps to 0.
+    template <typename OutputType>
+    struct UnormEncoder {
+        static_assert(std::is_unsigned_v<OutputType>, "UnormEncoder needs an unsigned integer type");
+        // Wider maxima are not representable as floats, so clamped values would not fit in the output type.
+        static_assert(sizeof(OutputType) <= 2, "UnormEncoder supports types of up to 16 bits");
+        using value_type = OutputType;
+
+        void operator()(const float* values, int count, OutputType* output) const noexcept {
+            constexpr float maxValue = std::numeric_limits<OutputType>::max();
+            const float scale = maxValue / (high - low);
+            int i = 0;
+#if defined(__AVX2__)
+            // Lanes clamp and truncate exactly like the scalar tail. maxps returns its second operand, 0, for NaN.
+            if constexpr (sizeof(OutputType) <= 2) {
+                const __m256 low8 = _mm256_set1_ps(low);
+                const __m256 scale8 = _mm256_set1_ps(scale);
+                const __m256 zero8 = _mm256_setzero_ps();
+                const __m256 max8 = _mm256_set1_ps(maxValue);
+                const __m256 half8 = _mm256_set1_ps(0.5f);
+                for (; i + 8 <= count; i += 8) {
+                    const __m256 value = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(
+                        _mm256_loadu_ps(values + i), low8), scale8), zero8), max8);
+                    const __m256i quantized = _mm256_cvttps_epi32(_mm256_add_ps(value, half8));
+                    const __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(quantized),
+                        _mm256_extracti128_si256(quantized, 1));
+                    if constexpr (sizeof(OutputType) == 2) {
+                        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), words);
+                    } else {
+                        _mm_storel_epi64(reinterpret_cast<__m128i*>(output + i), _mm_packus_epi16(words, words));
+                    }
+                }
+            }
+#endif
+            // Scalar fallback and tail. NaN fails the comparison and becomes 0, like it does in maxps.
+            for (; i < count; ++i) {
+                const float scaled = (values[i] - low) * scale;
+                const float value = (scaled > 0.0f) ? std::min(scaled, maxValue) : 0.0f;
+                output[i] = static_cast<OutputType>(value + 0.5f);
+            }
+        }
+
+        float low = 0.0f, high = 1.0f;
+    };
+
+    // IEEE 754 half precision bits, rounded to nearest even.
+    struct HalfEncoder {
+        using value_type = uint16_t;
+
+        static uint16_t toHalf(float value) noexcept {
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            const uint32_t sign = (bits >> 16) & 0x8000u;
+            const int exponent = static_cast<int>((bits >> 23) & 0xFFu) - 127 + 15;
+            uint32_t mantissa = bits & 0x7FFFFFu;
+            // Infinity and NaN.
+            if (exponent == 0xFF - 127 + 15) {
+                return sign | 0x7C00u | (mantissa ? 0x200u : 0u);
+            }
+            if (exponent >= 0x1F) {
+                return sign | 0x7C00u;
+            }
+            // Subnormal halves keep the implicit bit in the mantissa.
+            int shift = 13;
+            uint32_t half = static_cast<uint32_t>(exponent) << 10;
+            if (exponent <= 0) {
+                if (exponent < -10) {
+                    return sign;
+                }
+                mantissa |= 0x800000u;
+                shift = 14 - exponent;
+                half = 0;
+            }
+            half |= mantissa >> shift;
+            const uint32_t remainder = mantissa & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+            // A carry out of the mantissa correctly moves on to the next exponent.
+            if (remainder > halfway || (remainder == halfway && (half & 1u))) {
+                ++half;
+            }
+            return sign | half;
+        }
+
+        void operator()(const float* values, int count, uint16_t* output) const noexcept {
+            int i = 0;
+#if defined(__F16C__)
+            for (; i + 8 <= count; i += 8) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i),
+                    _mm256_cvtps_ph(_mm256_loadu_ps(values + i), _MM_FROUND_TO_NEAREST_INT));
+            }
+#endif
+            // Scalar fallback and tail.
+            for (; i < count; ++i) {
+                output[i] = toHalf(values[i]);
+            }
+        }
+    };
+
+    // Looks every value up in a table of colors spread evenly over [low, high]. Values outside are clamped, and NaN
+    // maps to the first color. low and high must differ.
+    struct PaletteEncoder {
+        using value_type = RGBA;
+
+        PaletteEncoder(std::vector<RGBA> colors, float low = 0.0f, float high = 1.0f)
+            : colors{std::move(colors)}, low{low}, high{high} { }
+
+        // A palette that blends linearly from one color to another.
+        static PaletteEncoder gradient(RGBA from, RGBA to, int size = 256, float low = 0.0f, float high = 1.0f) {
+            std::vector<RGBA> colors(size);
+            const auto blend = [](uint8_t from, uint8_t to, float t) {
+                return static_cast<uint8_t>(from + (to - from) * t + 0.5f);
+            };
+            for (int i = 0; i < size; ++i) {
+                const float t = (size == 1) ? 0.0f : i / (float) (size - 1);
+                colors[i] = RGBA{blend(from.r, to.r, t), blend(from.g, to.g, t), blend(from.b, to.b, t),
+                    blend(from.a, to.a, t)};
+            }
+            return PaletteEncoder{std::move(colors), low, high};
+        }
+
+        void operator()(const float* values, int count, RGBA* output) const noexcept {
+            assert(!colors.empty() && "PaletteEncoder needs at least one color");
+            assert(high != low && "PaletteEncoder needs distinct bounds");
+            const float maxIndex = colors.size() - 1;
+            const float scale = maxIndex / (high - low);
+            for (int i = 0; i < count; ++i) {
+                // NaN fails the comparison and picks the first color, like UnormEncoder encodes it as 0.
+                const float scaled = (values[i] - low) * scale;
+                const float index = (scaled > 0.0f) ? std::min(scaled, maxIndex) : 0.0f;
+                output[i] = colors[static_cast<int>(index + 0.5f)];
+            }
+        }
+
+        std::vector<RGBA> colors;
+        float low, high;
+    };
+} /* Stealth::Noise */
+
+#endif /* end of include guard: NOISE_ENCODERS_H */
@@ -0,0 +1,93 @@
+#ifndef NOISE_INSTRUMENTATION_H
+#define NOISE_INSTRUMENTATION_H
+#include <functional>
+#include <utility>
+#ifdef NOISE_GENERATOR_INSTRUMENTATION
+#include <chrono>
+#endif
+
+// Optional per-phase timing of the generators. Define NOISE_GENERATOR_INSTRUMENTATION before including the library to
+// enable it; otherwise every hook compiles to nothing and the sink is never called.
+namespace Stealth::Noise {
+    enum class Phase {
+        Lattice,
+        Attenuation,
+        Interpolation,
+        Normalization,
+    };
+
+    // One timed piece of work, and the octave it belongs to: 0 for the coarsest one, or -1 for work that spans all
+    // octaves (normalization), whose scales are 0 too. Scales alone do not identify the octave once they reach 1.
+    struct PhaseRecord {
+        Phase phase;
+        int octave;
+        int scaleX, scaleY, scaleZ;
+        long nanoseconds;
+        // Output elements written and lattice points drawn by this piece of work.
+        long voxels;
+        long latticePoints;
+    };
+
+    using InstrumentationSink = std::function<void(const PhaseRecord&)>;
+
+    inline InstrumentationSink& instrumentationSink() {
+        static InstrumentationSink sink{};
+        return sink;
+    }
+
+    // Set the function that receives every record. Multi-threaded generation calls it from several threads at once,
+    // and fused generation reports once per block, so the sink must be thread-safe and cheap. Set it while no
+    // generation is running. An empty sink disables reporting.
+    inline void setInstrumentationSink(InstrumentationSink sink) {
+        instrumentationSink() = std::move(sink);
+    }
+
+    namespace {
+#ifdef NOISE_GENERATOR_INSTRUMENTATION
+        // Times the work between its construction and stop(), or the end of its scope, and reports it to the sink.
+        class PhaseTimer {
+        public:
+            PhaseTimer(Phase phase, int octave, int scaleX, int scaleY, int scaleZ, long voxels = 0,
+                long latticePoints = 0) : mRecord{phase, octave, scaleX, scaleY, scaleZ, 0, voxels, latticePoints},
+                mStart{std::chrono::steady_clock::now()} { }
+
+            ~PhaseTimer() {
+                stop();
+            }
+
+            void stop() {
+                if (mStopped) {
+                    return;
+                }
+                mStopped = true;
+                if (const InstrumentationSink& sink = instrumentationSink()) {
+                    mRecord.nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - mStart).count();
+                    sink(mRecord);
+                }
+            }
+        private:
+            PhaseRecord mRecord;
+            std::chrono::steady_clock::time_point mStart;
+            bool mStopped = false;
+        };
+#else
+        class PhaseTimer {
+        public:
+            constexpr PhaseTimer(Phase, int, int, int, int, long = 0, long = 0) noexcept { }
+
+            constexpr void stop() noexcept { }
+        };
+#endif
+
+        // Time a single call, for work that happens in an initializer.
+        template <typename Function>
+        decltype(auto) instrumentPhase(Phase phase, int octave, int scaleX, int scaleY, int scaleZ, long voxels,
+            long latticePoints, Function&& func) {
+            PhaseTimer timer{phase, octave, scaleX, scaleY, scaleZ, voxels, latticePoints};
+            return func();
+        }
+    } /* Anonymous namespace */
+} /* Stealth::Noise */
+
+#endif /* end of include guard: NOISE_INSTRUMENTATION_H */
@@ -1,11 +1,212 @@
 #ifndef STEALTH_INTERPOLATION_H
 #define STEALTH_INTERPOLATION_H
+#include "Instrumentation.hpp"
+#include "Kernels.hpp"
 #include <Tensor3>
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
 #include <random>
+#include <type_traits>
+#include <thread>
+#include <vector>
 
 namespace Stealth::Noise {
-    using DefaultGenerator = std::mt19937;
+    // Lattices are drawn from a Lattice source (see DefaultLattice) rather than a sequential generator.
+    using DefaultGenerator [[deprecated("Lattices are drawn from DefaultLattice")]] = std::mt19937;
     using DefaultDistribution = std::uniform_real_distribution<float>;
+    // Number of output elements processed per block by the fused octave generators. Sized to stay resident in L2.
+    constexpr int FusedBlockSize = 1 << 16;
+
+    // Lattice source built on a murmur3/xxhash-style integer finalizer. Every lattice point gets its own key,
+    // derived from (seed, x, y, z), and a counter-based stream of draws on that key. Any point can therefore be
+    // drawn in O(1) without generating the points before it, in parallel and in any order.
+    struct HashedLattice {
+        static constexpr uint32_t mix(uint32_t h) noexcept {
+            h ^= h >> 16;
+            h *= 0x85EBCA6Bu;
+            h ^= h >> 13;
+            h *= 0xC2B2AE35u;
+            h ^= h >> 16;
+            return h;
+        }
+
+        static constexpr uint32_t seedKey(long seed) noexcept {
+            const uint64_t bits = static_cast<uint64_t>(seed);
+            return mix(static_cast<uint32_t>(bits) ^ mix(static_cast<uint32_t>(bits >> 32) + 0x9E3779B9u));
+        }
+
+        static constexpr uint32_t pointKey(uint32_t seedKey, int x, int y, int z) noexcept {
+            return mix(mix(mix(seedKey + static_cast<uint32_t>(x)) + static_cast<uint32_t>(y)) + static_cast<uint32_t>(z));
+        }
+
+        // The counter-th draw from the stream of a lattice point.
+        static constexpr uint32_t draw(uint32_t pointKey, uint32_t counter) noexcept {
+            return mix(pointKey + counter * 0x9E3779B9u);
+        }
+
+        // A uniform float in [0, 1) made from the counter-th draw of a lattice point.
+        static constexpr float canonical(uint32_t pointKey, uint32_t counter) noexcept {
+            return (draw(pointKey, counter) >> 8) * (1.0f / 16777216.0f);
+        }
+
+        // UniformRandomBitGenerator over the stream of one lattice point, used to feed arbitrary distributions.
+        class Engine {
+        public:
+            using result_type = uint32_t;
+
+            constexpr explicit Engine(uint32_t pointKey) noexcept : mPointKey{pointKey} { }
+
+            static constexpr result_type min() noexcept {
+                return 0;
+            }
+
+            static constexpr result_type max() noexcept {
+                return UINT32_MAX;
+            }
+
+            constexpr result_type operator()() noexcept {
+                return draw(mPointKey, mCounter++);
+            }
+        private:
+            uint32_t mPointKey, mCounter = 0;
+        };
+    };
+
+    using DefaultLattice = HashedLattice;
+
+    // Lattice whose point (x, y, z) is the point of Lattice at the coordinates {x, y, z}[axisX], [axisY], [axisZ].
+    template <typename Lattice, int axisX, int axisY, int axisZ>
+    struct PermutedLattice : Lattice {
+        static constexpr uint32_t pointKey(uint32_t seedKey, int x, int y, int z) noexcept {
+            const int coordinates[3]{x, y, z};
+            return Lattice::pointKey(seedKey, coordinates[axisX], coordinates[axisY], coordinates[axisZ]);
+        }
+    };
+
+    // The lattice generate draws a width x length x height map from. Maps that are flat along an axis are generated
+    // as 2D or 1D maps over their remaining axes, which moves those axes to the front of the lattice.
+    template <int width, int length, int height, typename Lattice = DefaultLattice>
+    using MapLattice = std::conditional_t<height == 1,
+        std::conditional_t<width == 1 && length != 1, PermutedLattice<Lattice, 1, 0, 2>, Lattice>,
+        std::conditional_t<length == 1,
+            std::conditional_t<width == 1, PermutedLattice<Lattice, 2, 0, 1>, PermutedLattice<Lattice, 0, 2, 1>>,
+            std::conditional_t<width == 1, PermutedLattice<Lattice, 1, 2, 0>, Lattice>>>;
+
+    // Seed used for a given octave of a map generated with seed. Octave 0 uses the seed itself.
+    constexpr long octaveSeed(long seed, int octave) noexcept {
+        return static_cast<long>(static_cast<uint64_t>(seed) + static_cast<uint64_t>(octave) * 0x9E3779B97F4A7C15ull);
+    }
+
+    // Seed of the lattice time slice at the given point on the time axis of an animated octave generated with seed.
+    // Slice 0 uses the seed itself.
+    constexpr long timeSliceSeed(long seed, int slice) noexcept {
+        return static_cast<long>(static_cast<uint64_t>(seed)
+            + static_cast<uint64_t>(static_cast<int64_t>(slice)) * 0xD1B54A32D192ED03ull);
+    }
+
+    // Persistent worker threads shared by every multithreaded generator, so that short octaves do not pay for
+    // thread start-up on each call. Workers are started lazily and only ever added, so steady-state runs do not
+    // allocate. Any thread may submit work, including a worker; the submitting thread always works on its own
+    // tasks, so nested and concurrent runs cannot deadlock.
+    class ThreadPool {
+    public:
+        ThreadPool() = default;
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock{mMutex};
+                mStopping = true;
+            }
+            mWake.notify_all();
+            for (auto& worker : mWorkers) {
+                worker.join();
+            }
+        }
+
+        // The pool used by parallelFor.
+        static ThreadPool& shared() {
+            static ThreadPool pool;
+            return pool;
+        }
+
+        int numWorkers() const {
+            std::lock_guard<std::mutex> lock{mMutex};
+            return static_cast<int>(mWorkers.size());
+        }
+
+        // Run func(task) for every task in [0, numTasks) on the calling thread and up to numThreads - 1 workers,
+        // and return once all of them have finished.
+        template <typename Function>
+        void run(int numTasks, int numThreads, Function&& func) {
+            Job job{[](void* context, int task) { (*static_cast<std::remove_reference_t<Function>*>(context))(task); },
+                &func, numTasks, numTasks};
+            std::unique_lock<std::mutex> lock{mMutex};
+            while (static_cast<int>(mWorkers.size()) < std::min(numThreads, numTasks) - 1) {
+                mWorkers.emplace_back([this] { work(); });
+            }
+            // Queue the job, then work on it alongside the workers.
+            *mTail = &job;
+            mTail = &job.next;
+            mWake.notify_all();
+            while (job.nextTask < job.numTasks) {
+                runTask(job, lock);
+            }
+            mDone.wait(lock, [&job] { return job.remaining == 0; });
+        }
+    private:
+        struct Job {
+            void (*invoke)(void*, int);
+            void* context;
+            int numTasks, remaining, nextTask = 0;
+            Job* next = nullptr;
+        };
+
+        // Claim the next task of a queued job and run it with the lock released. The job leaves the queue once
+        // its last task is claimed.
+        void runTask(Job& job, std::unique_lock<std::mutex>& lock) {
+            const int task = job.nextTask++;
+            if (job.nextTask == job.numTasks) {
+                Job** link = &mHead;
+                while (*link != &job) {
+                    link = &(*link)->next;
+                }
+                *link = job.next;
+                if (mTail == &job.next) {
+                    mTail = link;
+                }
+            }
+            lock.unlock();
+            job.invoke(job.context, task);
+            lock.lock();
+            if (--job.remaining == 0) {
+                mDone.notify_all();
+            }
+        }
+
+        void work() {
+            std::unique_lock<std::mutex> lock{mMutex};
+            while (true) {
+                mWake.wait(lock, [this] { return mStopping || mHead; });
+                if (!mHead) {
+                    return;
+                }
+                runTask(*mHead, lock);
+            }
+        }
+
+        mutable std::mutex mMutex;
+        std::condition_variable mWake, mDone;
+        std::vector<std::thread> mWorkers;
+        Job* mHead = nullptr;
+        Job** mTail = &mHead;
+        bool mStopping = false;
+    };
 
     namespace {
         float attenuationPolynomial(float distance) noexcept {
@@ -13,6 +214,12 @@ namespace Stealth::Noise {
             return (6 * pow(distance, 5) - 15 * pow(distance, 4) + 10 * pow(distance, 3));
         }
 
+        // Derivative of attenuationPolynomial with respect to distance. It is 0 at both ends of a tile, so gradients
+        // are continuous across tiles.
+        float attenuationDerivative(float distance) noexcept {
+            return (30 * pow(distance, 4) - 60 * pow(distance, 3) + 30 * pow(distance, 2));
+        }
+
         template <int scale>
         Tensor::Tensor3F<scale> generateAttenuations() noexcept {
             Tensor::Tensor3F<scale> attenuations;
@@ -22,9 +229,118 @@ namespace Stealth::Noise {
             return attenuations;
         }
 
-        template <int width, int length = 1, int height = 1, typename Distribution, typename Generator = DefaultGenerator>
+        // Draw the value of a single lattice point. Uniform and normal distributions are transformed directly from
+        // the point's draws (the latter with Box-Muller). Anything else is fed a fresh copy of the distribution
+        // and the point's own stream, so the result never depends on which points were drawn before it.
+        template <typename Lattice = DefaultLattice, typename Distribution>
+        float latticeValue(const Distribution& distribution, uint32_t pointKey) {
+            using DistributionType = std::decay_t<Distribution>;
+            if constexpr (std::is_same_v<DistributionType, std::uniform_real_distribution<float>>) {
+                return distribution.a() + (distribution.b() - distribution.a()) * Lattice::canonical(pointKey, 0);
+            } else if constexpr (std::is_same_v<DistributionType, std::normal_distribution<float>>) {
+                constexpr float twoPi = 6.28318530717958647692f;
+                const float radius = std::sqrt(-2.0f * std::log(1.0f - Lattice::canonical(pointKey, 0)));
+                return distribution.mean() + distribution.stddev() * radius
+                    * std::cos(twoPi * Lattice::canonical(pointKey, 1));
+            } else {
+                DistributionType pointDistribution{distribution};
+                typename Lattice::Engine engine{pointKey};
+                return pointDistribution(engine);
+            }
+        }
+
+        constexpr int32_t ceilDivide(int32_t x, int32_t y)
+        {
+            return (x + y - 1) / y;
+        }
+
+        // Rounds towards negative infinity, unlike integer division. y must be positive.
+        constexpr int32_t floorDivide(int32_t x, int32_t y)
+        {
+            return (x >= 0) ? x / y : -ceilDivide(-x, y);
+        }
+
+        // The lattice point at or before element of a map with the given scale. Lattice coordinates wrap around
+        // every 2^32 points, like the keys they are hashed into, so any element coordinate has one.
+        constexpr int latticeCoordinate(int64_t element, int scale) {
+            const int64_t point = (element >= 0) ? element / scale : -((-element + scale - 1) / scale);
+            return static_cast<int>(static_cast<uint32_t>(point));
+        }
+
+        // Where element lies in its lattice cell, in [0, scale).
+        constexpr int latticeOffset(int64_t element, int scale) {
+            const int64_t offset = element % scale;
+            return static_cast<int>((offset < 0) ? offset + scale : offset);
+        }
+
+        // Lattice coordinate offset points after coordinate, wrapping around like latticeCoordinate.
+        constexpr int latticeStep(int coordinate, int offset) {
+            return static_cast<int>(static_cast<uint32_t>(coordinate) + static_cast<uint32_t>(offset));
+        }
+
+        // Number of threads parallelFor actually uses for count items.
+        constexpr int numWorkerThreads(int count, int numThreads) {
+            return std::max(1, std::min(numThreads, count));
+        }
+
+        // Split [0, count) into contiguous chunks and run func(thread, begin, end) on each chunk, using the calling
+        // thread and the workers of the shared pool. Threads are numbered from 0 to
+        // numWorkerThreads(count, numThreads) - 1.
+        template <typename Function>
+        void parallelForEachThread(int count, int numThreads, Function&& func) {
+            numThreads = numWorkerThreads(count, numThreads);
+            if (numThreads == 1) {
+                func(0, 0, count);
+                return;
+            }
+            ThreadPool::shared().run(numThreads, numThreads, [&func, count, numThreads](int t) {
+                func(t, static_cast<int>((long) count * t / numThreads),
+                    static_cast<int>((long) count * (t + 1) / numThreads));
+            });
+        }
+
+        // Split [0, count) into contiguous chunks and run func(begin, end) on each chunk in parallel.
+        template <typename Function>
+        void parallelFor(int count, int numThreads, Function&& func) {
+            parallelForEachThread(count, numThreads, [&func](int, int begin, int end) {
+                func(begin, end);
+            });
+        }
+
+        // Draw a width x length x height block of lattice points, starting at lattice point (originX, originY, originZ),
+        // into every stride-th element of values. Rows are independent, so they are split across numThreads threads.
+        template <typename Lattice = DefaultLattice, typename Distribution>
+        void fillInternalNoiseMap(float* values, int width, int length, int height, long desiredSeed,
+            const Distribution& distribution, int numThreads = 1, int originX = 0, int originY = 0, int originZ = 0,
+            int stride = 1) {
+            const uint32_t seedKey = Lattice::seedKey(desiredSeed);
+            parallelFor(length * height, numThreads, [&](int beginRow, int endRow) {
+                for (int row = beginRow; row < endRow; ++row) {
+                    const int y = latticeStep(originY, row % length), z = latticeStep(originZ, row / length);
+                    float* rowValues = values + static_cast<size_t>(row) * width * stride;
+                    for (int x = 0; x < width; ++x) {
+                        rowValues[x * stride] = latticeValue<Lattice>(distribution,
+                            Lattice::pointKey(seedKey, latticeStep(originX, x), y, z));
+                    }
+                }
+            });
+        }
+
+        template <int width, int length = 1, int height = 1, typename Lattice = DefaultLattice, typename Distribution>
         auto generateInternalNoiseMap(long desiredSeed, Distribution&& distribution
-            = DefaultDistribution{0.f, 1.f}, Generator&& generator = DefaultGenerator{}) {
+            = DefaultDistribution{0.f, 1.f}, int numThreads = 1, int originX = 0, int originY = 0, int originZ = 0) {
+            Tensor::Tensor3F<width * length * height> tmp;
+            fillInternalNoiseMap<Lattice>(tmp.data(), width, length, height, desiredSeed, distribution, numThreads,
+                originX, originY, originZ);
+            return tmp;
+        }
+
+        // Draw the points one after the other from generator seeded with desiredSeed, the way lattices were drawn
+        // before they were hashed. Such lattices do not line up with chunks and cannot be drawn in parallel.
+        template <int width, int length = 1, int height = 1, typename Distribution, typename Generator,
+            typename = std::enable_if_t<!std::is_integral_v<std::decay_t<Generator>>>>
+        [[deprecated("Use the lattice overload of generateInternalNoiseMap")]]
+        auto generateInternalNoiseMap(long desiredSeed, Distribution&& distribution, Generator&& generator) {
             generator.seed(desiredSeed);
             constexpr int size = width * length * height;
             Tensor::Tensor3F<size> tmp;
@@ -34,9 +350,67 @@ namespace Stealth::Noise {
             return tmp;
         }
 
-        constexpr int32_t ceilDivide(int32_t x, int32_t y)
-        {
-            return (x + y - 1) / y;
+        // Break up the rows [beginRow, endRow) of a map with the given length into rectangular
+        // blocks of whole layers and call func(beginY, endY, beginZ, endZ) on each.
+        template <typename Function>
+        void forEachRowBlock(int beginRow, int endRow, int length, Function&& func) {
+            int beginZ = beginRow / length, beginY = beginRow % length;
+            const int endZ = endRow / length, endY = endRow % length;
+            if (beginZ == endZ) {
+                if (beginY < endY) {
+                    func(beginY, endY, beginZ, beginZ + 1);
+                }
+                return;
+            }
+            // Partial first layer...
+            if (beginY > 0) {
+                func(beginY, length, beginZ, beginZ + 1);
+                ++beginZ;
+            }
+            // ...whole layers...
+            if (beginZ < endZ) {
+                func(0, length, beginZ, endZ);
+            }
+            // ...and a partial last layer.
+            if (endY > 0) {
+                func(0, endY, endZ, endZ + 1);
+            }
+        }
+
+        // Split a map into blocks of whole rows, each holding roughly FusedBlockSize elements, and call
+        // func(beginY, endY, beginZ, endZ) on every rectangular piece. Blocks are spread across numThreads threads.
+        template <int width, int length, int height, typename Function>
+        void forEachFusedBlock(int numThreads, Function&& func) {
+            constexpr int rowsPerBlock = std::max(1, FusedBlockSize / width);
+            constexpr int numRows = length * height;
+            parallelFor(ceilDivide(numRows, rowsPerBlock), numThreads, [&](int beginBlock, int endBlock) {
+                for (int block = beginBlock; block < endBlock; ++block) {
+                    forEachRowBlock(block * rowsPerBlock, std::min((block + 1) * rowsPerBlock, numRows), length, func);
+                }
+            });
+        }
+
+        // Divide the rows [beginY, endY) of layers [beginZ, endZ) of the noise map by a normalization factor.
+        template <typename GeneratedNoiseType>
+        void normalizeBlock(GeneratedNoiseType& generatedNoiseMap, float normalizationFactor,
+            int beginY, int endY, int beginZ, int endZ) {
+            PhaseTimer timer{Phase::Normalization, -1, 0, 0, 0,
+                (long) (endY - beginY) * (endZ - beginZ) * generatedNoiseMap.width()};
+            for (int k = beginZ; k < endZ; ++k) {
+                divideRow(generatedNoiseMap.data() + beginY * generatedNoiseMap.width() + k * generatedNoiseMap.area(),
+                    (endY - beginY) * generatedNoiseMap.width(), normalizationFactor);
+            }
+        }
+
+        // Divide every element of the noise map by a normalization factor.
+        template <typename GeneratedNoiseType>
+        void normalize(GeneratedNoiseType& generatedNoiseMap, float normalizationFactor, int numThreads = 1) {
+            parallelFor(generatedNoiseMap.size(), numThreads, [&](int begin, int end) {
+                PhaseTimer timer{Phase::Normalization, -1, 0, 0, 0, end - begin};
+                for (int i = begin; i < end; ++i) {
+                    generatedNoiseMap(i) /= normalizationFactor;
+                }
+            });
         }
     } /* Anonymous namespace */
 } /* StealthWorldGenerator */
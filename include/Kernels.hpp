@@ -0,0 +1,298 @@
+#ifndef NOISE_KERNELS_H
+#define NOISE_KERNELS_H
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace Stealth::Noise {
+    namespace {
+        // Round a product before it is used. Compilers may otherwise contract a * b + c into a fused multiply-add
+        // (GCC does so by default on FMA targets), which rounds once instead of twice and so depends on the
+        // target and on how each expression happens to be written. Every product that feeds a sum goes through
+        // here, so all code paths agree bit for bit whatever -march and -ffp-contract are.
+        template <typename T>
+        inline T rounded(T product) noexcept {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__SSE2__))
+            asm("" : "+x"(product));
+#elif defined(__GNUC__) && defined(__aarch64__)
+            asm("" : "+w"(product));
+#endif
+            return product;
+        }
+
+        // Interpolate a whole row between left and right. Lanes compute left * (1 - a) + right * a with separately
+        // rounded products exactly like the scalar tail, so results do not depend on the instruction set. Callers
+        // whose attenuation tables are shorter than a vector pass their length as maxCount, so that only the loops
+        // that fit are compiled and GCC can see that no vector load runs past the table.
+        template <typename overwrite, int maxCount = (1 << 30)>
+        inline void interpolateRow(float* row, const float* attenuations, int count, float left, float right,
+            float multiplier = 1.0f) noexcept {
+            int i = 0;
+#if defined(__AVX__)
+            if constexpr (maxCount >= 8) {
+                const __m256 one8 = _mm256_set1_ps(1.0f);
+                const __m256 left8 = _mm256_set1_ps(left);
+                const __m256 right8 = _mm256_set1_ps(right);
+                const __m256 multiplier8 = _mm256_set1_ps(multiplier);
+                for (; i + 8 <= count; i += 8) {
+                    __m256 attenuation = _mm256_loadu_ps(attenuations + i);
+                    __m256 value = _mm256_add_ps(rounded(_mm256_mul_ps(left8, _mm256_sub_ps(one8, attenuation))),
+                        rounded(_mm256_mul_ps(right8, attenuation)));
+                    if constexpr (overwrite::value) {
+                        _mm256_storeu_ps(row + i, value);
+                    } else {
+                        _mm256_storeu_ps(row + i, _mm256_add_ps(_mm256_loadu_ps(row + i),
+                            rounded(_mm256_mul_ps(value, multiplier8))));
+                    }
+                }
+            }
+#endif
+#if defined(__SSE2__)
+            if constexpr (maxCount >= 4) {
+                const __m128 one4 = _mm_set1_ps(1.0f);
+                const __m128 left4 = _mm_set1_ps(left);
+                const __m128 right4 = _mm_set1_ps(right);
+                const __m128 multiplier4 = _mm_set1_ps(multiplier);
+                for (; i + 4 <= count; i += 4) {
+                    __m128 attenuation = _mm_loadu_ps(attenuations + i);
+                    __m128 value = _mm_add_ps(rounded(_mm_mul_ps(left4, _mm_sub_ps(one4, attenuation))),
+                        rounded(_mm_mul_ps(right4, attenuation)));
+                    if constexpr (overwrite::value) {
+                        _mm_storeu_ps(row + i, value);
+                    } else {
+                        _mm_storeu_ps(row + i, _mm_add_ps(_mm_loadu_ps(row + i),
+                            rounded(_mm_mul_ps(value, multiplier4))));
+                    }
+                }
+            }
+#endif
+            // Scalar fallback and tail.
+            for (; i < count; ++i) {
+                float value = rounded(left * (1.0f - attenuations[i])) + rounded(right * attenuations[i]);
+                if constexpr (overwrite::value) {
+                    row[i] = value;
+                } else {
+                    row[i] += rounded(value * multiplier);
+                }
+            }
+        }
+
+        // Interpolate count independent lanes, lane m between left[m] and right[m], with one attenuation. Every lane
+        // computes the same separately rounded products as interpolateRow, so a lane matches the row element it
+        // stands for bit for bit.
+        template <typename overwrite>
+        inline void interpolateLanes(float* lanes, const float* left, const float* right, int count, float attenuation,
+            float multiplier = 1.0f) noexcept {
+            const float inverse = 1.0f - attenuation;
+            int i = 0;
+#if defined(__AVX__)
+            const __m256 inverse8 = _mm256_set1_ps(inverse);
+            const __m256 attenuation8 = _mm256_set1_ps(attenuation);
+            const __m256 multiplier8 = _mm256_set1_ps(multiplier);
+            for (; i + 8 <= count; i += 8) {
+                __m256 value = _mm256_add_ps(rounded(_mm256_mul_ps(_mm256_loadu_ps(left + i), inverse8)),
+                    rounded(_mm256_mul_ps(_mm256_loadu_ps(right + i), attenuation8)));
+                if constexpr (overwrite::value) {
+                    _mm256_storeu_ps(lanes + i, value);
+                } else {
+                    _mm256_storeu_ps(lanes + i, _mm256_add_ps(_mm256_loadu_ps(lanes + i),
+                        rounded(_mm256_mul_ps(value, multiplier8))));
+                }
+            }
+#endif
+#if defined(__SSE2__)
+            const __m128 inverse4 = _mm_set1_ps(inverse);
+            const __m128 attenuation4 = _mm_set1_ps(attenuation);
+            const __m128 multiplier4 = _mm_set1_ps(multiplier);
+            for (; i + 4 <= count; i += 4) {
+                __m128 value = _mm_add_ps(rounded(_mm_mul_ps(_mm_loadu_ps(left + i), inverse4)),
+                    rounded(_mm_mul_ps(_mm_loadu_ps(right + i), attenuation4)));
+                if constexpr (overwrite::value) {
+                    _mm_storeu_ps(lanes + i, value);
+                } else {
+                    _mm_storeu_ps(lanes + i, _mm_add_ps(_mm_loadu_ps(lanes + i), rounded(_mm_mul_ps(value, multiplier4))));
+                }
+            }
+#endif
+            // Scalar fallback and tail.
+            for (; i < count; ++i) {
+                float value = rounded(left[i] * inverse) + rounded(right[i] * attenuation);
+                if constexpr (overwrite::value) {
+                    lanes[i] = value;
+                } else {
+                    lanes[i] += rounded(value * multiplier);
+                }
+            }
+        }
+
+        // Interpolate count independent lanes, lane m between left[m] and right[m] with its own attenuations[m], for
+        // point queries that each fall in a different cell. Lanes compute the same separately rounded products as
+        // interpolateRow, so a lane matches the element of the dense map it stands for bit for bit.
+        template <typename overwrite>
+        inline void interpolateQueries(float* lanes, const float* left, const float* right, const float* attenuations,
+            int count, float multiplier = 1.0f) noexcept {
+            int i = 0;
+#if defined(__AVX__)
+            const __m256 one8 = _mm256_set1_ps(1.0f);
+            const __m256 multiplier8 = _mm256_set1_ps(multiplier);
+            for (; i + 8 <= count; i += 8) {
+                __m256 attenuation = _mm256_loadu_ps(attenuations + i);
+                __m256 value = _mm256_add_ps(rounded(_mm256_mul_ps(_mm256_loadu_ps(left + i),
+                    _mm256_sub_ps(one8, attenuation))), rounded(_mm256_mul_ps(_mm256_loadu_ps(right + i), attenuation)));
+                if constexpr (overwrite::value) {
+                    _mm256_storeu_ps(lanes + i, value);
+                } else {
+                    _mm256_storeu_ps(lanes + i, _mm256_add_ps(_mm256_loadu_ps(lanes + i),
+                        rounded(_mm256_mul_ps(value, multiplier8))));
+                }
+            }
+#endif
+#if defined(__SSE2__)
+            const __m128 one4 = _mm_set1_ps(1.0f);
+            const __m128 multiplier4 = _mm_set1_ps(multiplier);
+            for (; i + 4 <= count; i += 4) {
+                __m128 attenuation = _mm_loadu_ps(attenuations + i);
+                __m128 value = _mm_add_ps(rounded(_mm_mul_ps(_mm_loadu_ps(left + i), _mm_sub_ps(one4, attenuation))),
+                    rounded(_mm_mul_ps(_mm_loadu_ps(right + i), attenuation)));
+                if constexpr (overwrite::value) {
+                    _mm_storeu_ps(lanes + i, value);
+                } else {
+                    _mm_storeu_ps(lanes + i, _mm_add_ps(_mm_loadu_ps(lanes + i), rounded(_mm_mul_ps(value, multiplier4))));
+                }
+            }
+#endif
+            // Scalar fallback and tail.
+            for (; i < count; ++i) {
+                float value = rounded(left[i] * (1.0f - attenuations[i])) + rounded(right[i] * attenuations[i]);
+                if constexpr (overwrite::value) {
+                    lanes[i] = value;
+                } else {
+                    lanes[i] += rounded(value * multiplier);
+                }
+            }
+        }
+
+        // interpolateRow for a row and its partial derivatives in one pass, so the attenuations are loaded once and
+        // every block is read and written once per octave. row interpolates between left and right exactly like
+        // interpolateRow. Derivatives are linear in the attenuations, so each one adds start + slope * attenuation,
+        // with the octave's multiplier already applied: slopeX along derivatives, the others along attenuations.
+        // gradientZ is only written if withZ. Always inlined, so callers with a fixed count keep their unrolled loops.
+        template <typename overwrite, bool withZ>
+        [[gnu::always_inline]] inline void interpolateGradientRow(float* row, float* gradientX, float* gradientY,
+            float* gradientZ, const float* attenuations, const float* derivatives, int count, float left, float right,
+            float multiplier, float slopeX, float startY, float slopeY, float startZ, float slopeZ) noexcept {
+            int i = 0;
+#if defined(__AVX__)
+            const __m256 one8 = _mm256_set1_ps(1.0f);
+            const __m256 left8 = _mm256_set1_ps(left);
+            const __m256 right8 = _mm256_set1_ps(right);
+            const __m256 multiplier8 = _mm256_set1_ps(multiplier);
+            const __m256 slopeX8 = _mm256_set1_ps(slopeX);
+            const __m256 startY8 = _mm256_set1_ps(startY);
+            const __m256 slopeY8 = _mm256_set1_ps(slopeY);
+            const __m256 startZ8 = _mm256_set1_ps(startZ);
+            const __m256 slopeZ8 = _mm256_set1_ps(slopeZ);
+            for (; i + 8 <= count; i += 8) {
+                const __m256 attenuation = _mm256_loadu_ps(attenuations + i);
+                const __m256 value = _mm256_add_ps(rounded(_mm256_mul_ps(left8, _mm256_sub_ps(one8, attenuation))),
+                    rounded(_mm256_mul_ps(right8, attenuation)));
+                const __m256 x = rounded(_mm256_mul_ps(slopeX8, _mm256_loadu_ps(derivatives + i)));
+                const __m256 y = _mm256_add_ps(startY8, rounded(_mm256_mul_ps(slopeY8, attenuation)));
+                if constexpr (overwrite::value) {
+                    _mm256_storeu_ps(row + i, value);
+                    _mm256_storeu_ps(gradientX + i, x);
+                    _mm256_storeu_ps(gradientY + i, y);
+                } else {
+                    _mm256_storeu_ps(row + i, _mm256_add_ps(_mm256_loadu_ps(row + i),
+                        rounded(_mm256_mul_ps(value, multiplier8))));
+                    _mm256_storeu_ps(gradientX + i, _mm256_add_ps(_mm256_loadu_ps(gradientX + i), x));
+                    _mm256_storeu_ps(gradientY + i, _mm256_add_ps(_mm256_loadu_ps(gradientY + i), y));
+                }
+                if constexpr (withZ) {
+                    const __m256 z = _mm256_add_ps(startZ8, rounded(_mm256_mul_ps(slopeZ8, attenuation)));
+                    _mm256_storeu_ps(gradientZ + i, overwrite::value ? z
+                        : _mm256_add_ps(_mm256_loadu_ps(gradientZ + i), z));
+                }
+            }
+#endif
+#if defined(__SSE2__)
+            const __m128 one4 = _mm_set1_ps(1.0f);
+            const __m128 left4 = _mm_set1_ps(left);
+            const __m128 right4 = _mm_set1_ps(right);
+            const __m128 multiplier4 = _mm_set1_ps(multiplier);
+            const __m128 slopeX4 = _mm_set1_ps(slopeX);
+            const __m128 startY4 = _mm_set1_ps(startY);
+            const __m128 slopeY4 = _mm_set1_ps(slopeY);
+            const __m128 startZ4 = _mm_set1_ps(startZ);
+            const __m128 slopeZ4 = _mm_set1_ps(slopeZ);
+            for (; i + 4 <= count; i += 4) {
+                const __m128 attenuation = _mm_loadu_ps(attenuations + i);
+                const __m128 value = _mm_add_ps(rounded(_mm_mul_ps(left4, _mm_sub_ps(one4, attenuation))),
+                    rounded(_mm_mul_ps(right4, attenuation)));
+                const __m128 x = rounded(_mm_mul_ps(slopeX4, _mm_loadu_ps(derivatives + i)));
+                const __m128 y = _mm_add_ps(startY4, rounded(_mm_mul_ps(slopeY4, attenuation)));
+                if constexpr (overwrite::value) {
+                    _mm_storeu_ps(row + i, value);
+                    _mm_storeu_ps(gradientX + i, x);
+                    _mm_storeu_ps(gradientY + i, y);
+                } else {
+                    _mm_storeu_ps(row + i, _mm_add_ps(_mm_loadu_ps(row + i), rounded(_mm_mul_ps(value, multiplier4))));
+                    _mm_storeu_ps(gradientX + i, _mm_add_ps(_mm_loadu_ps(gradientX + i), x));
+                    _mm_storeu_ps(gradientY + i, _mm_add_ps(_mm_loadu_ps(gradientY + i), y));
+                }
+                if constexpr (withZ) {
+                    const __m128 z = _mm_add_ps(startZ4, rounded(_mm_mul_ps(slopeZ4, attenuation)));
+                    _mm_storeu_ps(gradientZ + i, overwrite::value ? z : _mm_add_ps(_mm_loadu_ps(gradientZ + i), z));
+                }
+            }
+#endif
+            // Scalar fallback and tail.
+            for (; i < count; ++i) {
+                const float value = rounded(left * (1.0f - attenuations[i])) + rounded(right * attenuations[i]);
+                const float x = rounded(slopeX * derivatives[i]);
+                const float y = startY + rounded(slopeY * attenuations[i]);
+                if constexpr (overwrite::value) {
+                    row[i] = value;
+                    gradientX[i] = x;
+                    gradientY[i] = y;
+                } else {
+                    row[i] += rounded(value * multiplier);
+                    gradientX[i] += x;
+                    gradientY[i] += y;
+                }
+                if constexpr (withZ) {
+                    const float z = startZ + rounded(slopeZ * attenuations[i]);
+                    gradientZ[i] = overwrite::value ? z : gradientZ[i] + z;
+                }
+            }
+        }
+
+        // Divide a whole row by a normalization factor into output, which may be row itself. Uses a true division so
+        // results match the scalar tail.
+        inline void divideRow(const float* row, int count, float normalizationFactor, float* output) noexcept {
+            int i = 0;
+#if defined(__AVX__)
+            const __m256 factor8 = _mm256_set1_ps(normalizationFactor);
+            for (; i + 8 <= count; i += 8) {
+                _mm256_storeu_ps(output + i, _mm256_div_ps(_mm256_loadu_ps(row + i), factor8));
+            }
+#endif
+#if defined(__SSE2__)
+            const __m128 factor4 = _mm_set1_ps(normalizationFactor);
+            for (; i + 4 <= count; i += 4) {
+                _mm_storeu_ps(output + i, _mm_div_ps(_mm_loadu_ps(row + i), factor4));
+            }
+#endif
+            // Scalar fallback and tail.
+            for (; i < count; ++i) {
+                output[i] = row[i] / normalizationFactor;
+            }
+        }
+
+        inline void divideRow(float* row, int count, float normalizationFactor) noexcept {
+            divideRow(row, count, normalizationFactor, row);
+        }
+    } /* Anonymous namespace */
+} /* Stealth::Noise */
+
+#endif /* end of include guard: NOISE_KERNELS_H */
@@ -0,0 +1,1265 @@
+#ifndef NOISE_ENGINE_H
+#define NOISE_ENGINE_H
+#include "NoiseGenerator1D.hpp"
+#include "Encoders.hpp"
+#include "Instrumentation.hpp"
+#include "Internal.hpp"
+#include "Kernels.hpp"
+#include <any>
+#include <array>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace Stealth::Noise {
+    // Scratch memory for NoiseEngine. The buffer grows to fit the largest plan it is used with and is then reused
+    // across octaves, calls and frames, so steady-state generation with a single thread never touches the heap.
+    class NoiseWorkspace {
+    public:
+        // Storage for at least size floats. Contents are unspecified.
+        float* reserve(size_t size) {
+            if (mBuffer.size() < size) {
+                mBuffer.resize(size);
+                ++mAllocations;
+            }
+            return mBuffer.data();
+        }
+
+        // Number of times the workspace has had to allocate.
+        long allocations() const noexcept {
+            return mAllocations;
+        }
+
+        size_t size() const noexcept {
+            return mBuffer.size();
+        }
+    private:
+        std::vector<float> mBuffer;
+        long mAllocations = 0;
+    };
+
+    // What the lattice values in a cache were drawn for, apart from where they are. Engines are compared by their
+    // parameters rather than their address, so a cache notices a new engine that reuses a destroyed one's address,
+    // and keeps its values for copies of the same engine. Distributions are compared by their param().
+    class LatticeKey {
+    public:
+        // Make this the key of engine, distribution and seed. Returns whether it changed.
+        template <typename Engine, typename Distribution>
+        bool update(const Engine& engine, const Distribution& distribution, long seed) {
+            using Parameters = typename std::decay_t<Distribution>::param_type;
+            // Every other octave's scales follow from the first one's.
+            const auto& octave = engine.octaves().front();
+            const std::array<int, 7> shape{engine.width(), engine.length(), engine.height(), octave.scaleX,
+                octave.scaleY, octave.scaleZ, engine.numOctaves()};
+            const Parameters* parameters = std::any_cast<Parameters>(&mParameters);
+            if (parameters && *parameters == distribution.param() && shape == mShape && seed == mSeed) {
+                return false;
+            }
+            mParameters = distribution.param();
+            mShape = shape;
+            mSeed = seed;
+            return true;
+        }
+
+        void clear() noexcept {
+            mParameters.reset();
+        }
+    private:
+        std::any mParameters;
+        std::array<int, 7> mShape{};
+        long mSeed = 0;
+    };
+
+    // Lattice layers kept between calls to NoiseEngine::generateLayers. Switching to another engine, seed or
+    // distribution discards them.
+    class NoiseLayerCache {
+    public:
+        // Lattice layers [firstLayer, firstLayer + numLayers) of one octave.
+        struct Layers {
+            std::vector<float> values;
+            int firstLayer = 0, numLayers = 0;
+        };
+
+        // The layers of every octave of engine with the given distribution and seed.
+        template <typename Engine, typename Distribution>
+        std::vector<Layers>& layers(const Engine& engine, const Distribution& distribution, long seed) {
+            if (mKey.update(engine, distribution, seed)) {
+                mLayers.assign(engine.numOctaves(), Layers{});
+            }
+            return mLayers;
+        }
+
+        void clear() {
+            mKey.clear();
+            mLayers.clear();
+        }
+    private:
+        LatticeKey mKey;
+        std::vector<Layers> mLayers;
+    };
+
+    // Lattice time slices kept between calls to NoiseEngine::generateChunkFrame. Switching to another engine, seed,
+    // distribution, chunk or time scale discards them.
+    class NoiseTimeCache {
+    public:
+        // One octave's lattice window at time slices firstSlice and firstSlice + 1.
+        struct Slices {
+            std::vector<float> first, second;
+            int firstSlice = 0;
+            bool valid = false;
+        };
+
+        // The slices of every octave of engine with the given distribution, seed, chunk and time scale.
+        template <typename Engine, typename Distribution>
+        std::vector<Slices>& slices(const Engine& engine, const Distribution& distribution, long seed, int chunkX,
+            int chunkY, int chunkZ, int timeScale) {
+            // Update the key first, so it always describes the slices.
+            const bool keyChanged = mKey.update(engine, distribution, seed);
+            if (keyChanged || chunkX != mChunkX || chunkY != mChunkY || chunkZ != mChunkZ || timeScale != mTimeScale) {
+                mChunkX = chunkX;
+                mChunkY = chunkY;
+                mChunkZ = chunkZ;
+                mTimeScale = timeScale;
+                mSlices.assign(engine.numOctaves(), Slices{});
+            }
+            return mSlices;
+        }
+
+        // Storage for a slice of size floats that is about to be drawn.
+        float* draw(std::vector<float>& slice, size_t size) {
+            slice.resize(size);
+            ++mSlicesDrawn;
+            return slice.data();
+        }
+
+        // Number of lattice slices drawn since the cache was created.
+        long slicesDrawn() const noexcept {
+            return mSlicesDrawn;
+        }
+
+        void clear() {
+            mKey.clear();
+            mSlices.clear();
+        }
+    private:
+        LatticeKey mKey;
+        int mChunkX = 0, mChunkY = 0, mChunkZ = 0, mTimeScale = 0;
+        std::vector<Slices> mSlices;
+        long mSlicesDrawn = 0;
+    };
+
+    // Runtime counterpart of the generateOctaves/generateChunk templates. Sizes, scales and octave counts are
+    // plain values, so one compiled engine serves every map shape. Construction builds a reusable plan: the
+    // attenuation tables and internal noise map shape of every octave, and the block schedule used to walk the
+    // output. Generation then runs the same row kernels as the templates and produces bit-identical maps: flat maps
+    // draw from the same relabeled lattices (see MapLattice), and are still interpolated along their flat axes, so
+    // chunks stacked along one vary smoothly.
+    class NoiseEngine {
+    public:
+        // Everything one octave needs, independent of the seed and of where the map sits in the noise field.
+        struct Octave {
+            // Position in the stack, starting at 0 for the coarsest octave.
+            int index;
+            int scaleX, scaleY, scaleZ;
+            int internalWidth, internalLength, internalHeight;
+            // Where this octave's internal noise map lives in the workspace.
+            size_t internalOffset;
+            float multiplier;
+            std::vector<float> attenuationsX, attenuationsY, attenuationsZ;
+            // Derivatives of the attenuations per element, for gradients.
+            std::vector<float> derivativesX, derivativesY, derivativesZ;
+        };
+
+        NoiseEngine(int width, int length, int height, int scaleX, int scaleY, int scaleZ, int numOctaves = 6,
+            float decayFactor = 0.5f) : mWidth{width}, mLength{length}, mHeight{height}, mDecayFactor{decayFactor} {
+            if (width < 1 || length < 1 || height < 1 || scaleX < 1 || scaleY < 1 || scaleZ < 1 || numOctaves < 1) {
+                throw std::invalid_argument{"NoiseEngine needs positive sizes, scales and octave counts"};
+            }
+            if (static_cast<int64_t>(width) * length * height > std::numeric_limits<int>::max()) {
+                throw std::invalid_argument{"NoiseEngine maps must have fewer than 2^31 elements"};
+            }
+            mRowsPerBlock = std::max(1, FusedBlockSize / width);
+            mNumBlocks = ceilDivide(length * height, mRowsPerBlock);
+            float accumulator = 1.0f;
+            for (int i = 0; i < numOctaves; ++i) {
+                Octave octave;
+                octave.index = i;
+                octave.scaleX = scaleX;
+                octave.scaleY = scaleY;
+                octave.scaleZ = scaleZ;
+                // An unaligned origin can straddle one more lattice cell than an aligned one.
+                octave.internalWidth = ceilDivide(width, scaleX) + 2;
+                octave.internalLength = ceilDivide(length, scaleY) + 2;
+                octave.internalHeight = ceilDivide(height, scaleZ) + 2;
+                octave.internalOffset = mWorkspaceSize;
+                mWorkspaceSize += static_cast<size_t>(octave.internalWidth) * octave.internalLength
+                    * octave.internalHeight;
+                octave.multiplier = accumulator;
+                PhaseTimer timer{Phase::Attenuation, i, scaleX, scaleY, scaleZ};
+                octave.attenuationsX = generateAttenuations(scaleX);
+                octave.attenuationsY = generateAttenuations(scaleY);
+                octave.attenuationsZ = generateAttenuations(scaleZ);
+                octave.derivativesX = generateAttenuationDerivatives(scaleX);
+                octave.derivativesY = generateAttenuationDerivatives(scaleY);
+                octave.derivativesZ = generateAttenuationDerivatives(scaleZ);
+                timer.stop();
+                mOctaves.emplace_back(std::move(octave));
+                // Next octave
+                scaleX = ceilDivide(scaleX, 2);
+                scaleY = ceilDivide(scaleY, 2);
+                scaleZ = ceilDivide(scaleZ, 2);
+                accumulator *= decayFactor;
+            }
+            // Sum from the last octave so the factor matches the templates exactly.
+            for (auto octave = mOctaves.rbegin(); octave != mOctaves.rend(); ++octave) {
+                mNormalizationFactor = octave->multiplier + mNormalizationFactor;
+            }
+        }
+
+        // Same result as generateOctaves with the engine's shape. The map can be any contiguous container of
+        // width * length * height floats, such as a Tensor3F or a std::vector<float>.
+        template <typename GeneratedNoiseType, typename Distribution = DefaultDistribution>
+        GeneratedNoiseType& generateOctaves(GeneratedNoiseType& generatedNoiseMap, NoiseWorkspace& workspace,
+            Distribution&& distribution = DefaultDistribution{0.f, 1.f}, long seed = 0, int numThreads = 1) const {
+            return generateChunk(generatedNoiseMap, workspace, 0, 0, 0, std::forward<Distribution&&>(distribution), seed,
+                numThreads);
+        }
+
+        // Same result as generateChunk with the engine's shape.
+        template <typename GeneratedNoiseType, typename Distribution = DefaultDistribution>
+        GeneratedNoiseType& generateChunk(GeneratedNoiseType& generatedNoiseMap, NoiseWorkspace& workspace, int chunkX,
+            int chunkY, int chunkZ, Distribution&& distribution = DefaultDistribution{0.f, 1.f}, long seed = 0,
+            int numThreads = 1) const {
+            float* output = generatedNoiseMap.data();
+            float* internalNoiseMaps = workspace.reserve(mWorkspaceSize);
+            generateBlocks(internalNoiseMaps, chunkX, chunkY, chunkZ, distribution, seed, numThreads,
+                [output](int, int offset) { return output + offset; }, [](const float*, int, int) { });
+            return generatedNoiseMap;
+        }
+
+        // Same as generateOctaves, but every normalized value is passed through an encoder (see Encoders.hpp) and
+        // only the encoded map is written. Blocks are accumulated in per-thread scratch space in the workspace
+        // and encoded while still in cache, so no float map is ever stored. The map can be any contiguous
+        // container of width * length * height Encoder::value_type elements.
+        template <typename EncodedNoiseType, typename Encoder, typename Distribution = DefaultDistribution>
+        EncodedNoiseType& generateOctavesEncoded(EncodedNoiseType& encodedNoiseMap, NoiseWorkspace& workspace,
+            const Encoder& encoder, Distribution&& distribution = DefaultDistribution{0.f, 1.f}, long seed = 0,
+            int numThreads = 1) const {
+            return generateChunkEncoded(encodedNoiseMap, workspace, encoder, 0, 0, 0,
+                std::forward<Distribution&&>(distribution), seed, numThreads);
+        }
+
+        template <typename EncodedNoiseType, typename Encoder, typename Distribution = DefaultDistribution>
+        EncodedNoiseType& generateChunkEncoded(EncodedNoiseType& encodedNoiseMap, NoiseWorkspace& workspace,
+            const Encoder& encoder, int chunkX, int chunkY, int chunkZ, Distribution&& distribution
+            = DefaultDistribution{0.f, 1.f}, long seed = 0, int numThreads = 1) const {
+            typename Encoder::value_type* output = encodedNoiseMap.data();
+            const int blockSize = mRowsPerBlock * mWidth;
+            float* internalNoiseMaps = workspace.reserve(mWorkspaceSize
+                + static_cast<size_t>(numWorkerThreads(mNumBlocks, numThreads)) * blockSize);
+            float* scratch = internalNoiseMaps + mWorkspaceSize;
+            generateBlocks(internalNoiseMaps, chunkX, chunkY, chunkZ, distribution, seed, numThreads,
+                [scratch, blockSize](int thread, int) { return scratch + thread * blockSize; },
+                [&encoder, output](const float* block, int offset, int count) {
+                    encoder(block, count, output + offset);
+                });
+            return encodedNoiseMap;
+        }
+
+        // Convenience overloads that allocate a workspace for a single call.
+        template <typename GeneratedNoiseType, typename Distribution = DefaultDistribution>
+        GeneratedNoiseType& generateOctaves(GeneratedNoiseType& generatedNoiseMap, Distribution&& distribution
+            = DefaultDistribution{0.f, 1.f}, long seed = 0, int numThreads = 1) const {
+            NoiseWorkspace workspace{};
+            return generateOctaves(generatedNoiseMap, workspace, std::forward<Distribution&&>(distribution), seed,
+                numThreads);
+        }
+
+        template <typename GeneratedNoiseType, typename Distribution = DefaultDistribution>
+        GeneratedNoiseType& generateChunk(GeneratedNoiseType& generatedNoiseMap, int chunkX, int chunkY, int chunkZ,
+            Distribution&& distribution = DefaultDistribution{0.f, 1.f}, long seed = 0, int numThreads = 1) const {
+            NoiseWorkspace workspace{};
+            return generateChunk(generatedNoiseMap, workspace, chunkX, chunkY, chunkZ,
+                std::forward<Distribution&&>(distribution), seed, numThreads);
+        }
+
+        template <typename EncodedNoiseType, typename Encoder, typename Distribution = DefaultDistribution>
+        EncodedNoiseType& generateOctavesEncoded(EncodedNoiseType& encodedNoiseMap, const Encoder& encoder,
+            Distribution&& distribution = DefaultDistribution{0.f, 1.f}, long seed = 0, int numThreads = 1) const {
+            NoiseWorkspace workspace{};
+            return generateOctavesEncoded(encodedNoiseMap, workspace, encoder,
+                std::forward<Distribution&&>(distribution), seed, numThreads);
+        }
+
+        template <typename EncodedNoiseType, typename Encoder, typename Distribution = DefaultDistribution>
+        EncodedNoiseType& generateChunkEncoded(EncodedNoiseType& encodedNoiseMap, const Encoder& encoder, int chunkX,
+            int chunkY, int chunkZ, Distribution&& distribution = DefaultDistribution{0.f, 1.f}, long seed = 0,
+            int numThreads = 1) const {
+            NoiseWorkspace workspace{};
+            return generateChunkEncoded(encodedNoiseMap, workspace, encoder, chunkX, chunkY, chunkZ,
+                std::forward<Distribution&&>(distribution), seed, numThreads);
+        }
+
+        // Generate the width x length x height box of the noise field whose first element sits at
+        // (originX, originY, originZ), in the same coordinates as generateChunk, so it matches the dense maps exactly.
+        // The box must fit in the engine's shape. Element (x, y, z) of the box is written to
+        // output[x + y * rowStride + z * layerStride], so it can land anywhere inside a larger map. The cost is
+        // proportional to the size of the box.
+        template <typename Distribution = DefaultDistribution>
+        void generateRegion(float* output, int rowStride, int layerStride, NoiseWorkspace& workspace, int64_t originX,
+            int64_t originY, int64_t originZ, int width, int length, int height, Distribution&& distribution
+            = DefaultDistribution{0.f, 1.f}, long seed = 0, int numThreads = 1) const {
+            if (width <= 0 || length <= 0 || height <= 0) {
+                return;
+            }
+            // Draw the part of every octave's lattice that the box overlaps.
+            float* internalNoiseMaps = workspace.reserve(mWorkspaceSize);
+            for (int i = 0; i < numOctaves(); ++i) {
+                const Octave& octave = mOctaves[i];
+                const LatticeWindow window = latticeWindow(octave, originX, originY, originZ, width, length, height);
+                PhaseTimer timer{Phase::Lattice, octave.index, octave.scaleX, octave.scaleY, octave.scaleZ, 0,
+                    (long) window.width * window.length * window.height};
+                drawLattice(internalNoiseMaps + octave.internalOffset, window.width, window.length, window.height,
+                    octaveSeed(seed, i), distribution, numThreads, window.x, window.y, window.z);
+            }
+            interpolateRegion(output, rowStride, layerStride, originX, originY, originZ, width, length, height,
+                numThreads, [&](int i) { return internalNoiseMaps + mOctaves[i].internalOffset; });
+        }
+
+        // Generate the layers [beginZ, endZ) of the map generateOctaves produces into output, which holds
+        // (endZ - beginZ) * width * length floats. The cache keeps the lattice layers the last call used, so
+        // generating a volume a few layers at a time, in order, draws every lattice layer only once and only needs
+        // memory for the lattice layers around the current slab. Switching the cache to another engine, seed or
+        // distribution starts over.
+        template <typename Distribution = DefaultDistribution>
+        void generateLayers(float* output, NoiseLayerCache& cache, int beginZ, int endZ, Distribution&& distribution
+            = DefaultDistribution{0.f, 1.f}, long seed = 0, int numThreads = 1) const {
+            if (beginZ >= endZ) {
+                return;
+            }
+            std::vector<NoiseLayerCache::Layers>& octaveLayers = cache.layers(*this, distribution, seed);
+            for (int i = 0; i < numOctaves(); ++i) {
+                const Octave& octave = mOctaves[i];
+                const LatticeWindow window = latticeWindow(octave, 0, 0, beginZ, mWidth, mLength, endZ - beginZ);
+                const size_t layerSize = static_cast<size_t>(window.width) * window.length;
+                NoiseLayerCache::Layers& layers = octaveLayers[i];
+                // Layers the previous call already drew are moved to the front instead of being drawn again.
+                const int cachedEnd = layers.firstLayer + layers.numLayers;
+                const int numKept = (layers.firstLayer <= window.z && window.z < cachedEnd)
+                    ? std::min(cachedEnd, window.z + window.height) - window.z : 0;
+                if (layers.values.size() < window.height * layerSize) {
+                    layers.values.resize(window.height * layerSize);
+                }
+                if (numKept > 0) {
+                    std::copy_n(layers.values.data() + (window.z - layers.firstLayer) * layerSize, numKept * layerSize,
+                        layers.values.data());
+                }
+                const int firstNew = window.z + numKept;
+                PhaseTimer timer{Phase::Lattice, octave.index, octave.scaleX, octave.scaleY, octave.scaleZ, 0,
+                    (long) ((window.z + window.height - firstNew) * layerSize)};
+                drawLattice(layers.values.data() + (firstNew - window.z) * layerSize, window.width, window.length,
+                    window.z + window.height - firstNew, octaveSeed(seed, i), distribution, numThreads, window.x,
+                    window.y, firstNew);
+                timer.stop();
+                layers.firstLayer = window.z;
+                layers.numLayers = window.height;
+            }
+            interpolateRegion(output, mWidth, mWidth * mLength, 0, 0, beginZ, mWidth, mLength, endZ - beginZ, numThreads,
+                [&](int i) { return octaveLayers[i].values.data(); });
+        }
+
+        // Generate frame number frame of a chunk animated through time. The noise field gets a time axis whose
+        // lattice points are timeScale frames apart in the first octave and, like the other axes, twice as close in
+        // every following octave down to 2 frames apart, so consecutive frames change smoothly and deep octaves are
+        // not redrawn every frame. Frame 0 is the map generateChunk produces.
+        // Every octave only needs the lattice time slices just before and after the frame. The cache keeps them,
+        // so playing frames in order draws a new slice only when an octave crosses a lattice point in time. The
+        // slices are blended first, so a frame costs one interpolation pass. Throws std::invalid_argument if
+        // timeScale is less than 1.
+        template <typename GeneratedNoiseType, typename Distribution = DefaultDistribution>
+        GeneratedNoiseType& generateChunkFrame(GeneratedNoiseType& generatedNoiseMap, NoiseTimeCache& cache,
+            NoiseWorkspace& workspace, int frame, int timeScale, int chunkX, int chunkY, int chunkZ,
+            Distribution&& distribution = DefaultDistribution{0.f, 1.f}, long seed = 0, int numThreads = 1) const {
+            if (timeScale < 1) {
+                throw std::invalid_argument{"Animated noise needs a positive time scale"};
+            }
+            const int64_t originX = chunkOrigin(chunkX, mWidth), originY = chunkOrigin(chunkY, mLength),
+                originZ = chunkOrigin(chunkZ, mHeight);
+            std::vector<NoiseTimeCache::Slices>& octaveSlices = cache.slices(*this, distribution, seed, chunkX, chunkY,
+                chunkZ, timeScale);
+            float* internalNoiseMaps = workspace.reserve(mWorkspaceSize);
+            int scaleT = timeScale;
+            for (int i = 0; i < numOctaves(); ++i, scaleT = nextTimeScale(scaleT)) {
+                const Octave& octave = mOctaves[i];
+                const LatticeWindow window = latticeWindow(octave, originX, originY, originZ, mWidth, mLength, mHeight);
+                blendTimeSlices(cache, octave, octaveSlices[i], frame, scaleT,
+                    static_cast<size_t>(window.width) * window.length * window.height,
+                    internalNoiseMaps + octave.internalOffset, [&](float* slice, int sliceIndex) {
+                        drawLattice(slice, window.width, window.length, window.height,
+                            timeSliceSeed(octaveSeed(seed, i), sliceIndex), distribution, numThreads, window.x,
+                            window.y, window.z);
+                    });
+            }
+            interpolateRegion(generatedNoiseMap.data(), mWidth, mWidth * mLength, originX, originY, originZ, mWidth,
+                mLength, mHeight, numThreads, [&](int i) { return internalNoiseMaps + mOctaves[i].internalOffset; });
+            return generatedNoiseMap;
+        }
+
+        // Same as generateChunkFrame for chunk (0, 0, 0).
+        template <typename GeneratedNoiseType, typename Distribution = DefaultDistribution>
+        GeneratedNoiseType& generateFrame(GeneratedNoiseType& generatedNoiseMap, NoiseTimeCache& cache,
+            NoiseWorkspace& workspace, int frame, int timeScale, Distribution&& distribution
+            = DefaultDistribution{0.f, 1.f}, long seed = 0, int numThreads = 1) const {
+            return generateChunkFrame(generatedNoiseMap, cache, workspace, frame, timeScale, 0, 0, 0,
+                std::forward<Distribution&&>(distribution), seed, numThreads);
+        }
+
+        // Generate count maps of the engine's shape at once, map i from seeds[i] and distributions[i]. Each map is the
+        // same as a separate generateChunk call would produce. The lattices of all maps are drawn interleaved and the
+        // kernels give every map a SIMD lane, so each tile's attenuations and corner bookkeeping are shared by all
+        // maps.
+        template <typename GeneratedNoiseType, typename Distribution>
+        void generateChunkBatch(GeneratedNoiseType* generatedNoiseMaps, const long* seeds,
+            const Distribution* distributions, int count, NoiseWorkspace& workspace, int chunkX, int chunkY, int chunkZ,
+            int numThreads = 1) const {
+            generateBatch(generatedNoiseMaps, seeds, count, workspace, chunkX, chunkY, chunkZ, numThreads,
+                [&](int map) -> const Distribution& { return distributions[map]; });
+        }
+
+        // Same as generateChunkBatch, with every map drawn from one distribution.
+        template <typename GeneratedNoiseType, typename Distribution = DefaultDistribution>
+        void generateChunkBatch(GeneratedNoiseType* generatedNoiseMaps, const long* seeds, int count,
+            NoiseWorkspace& workspace, int chunkX, int chunkY, int chunkZ,
+            const Distribution& distribution = DefaultDistribution{0.f, 1.f}, int numThreads = 1) const {
+            generateBatch(generatedNoiseMaps, seeds, count, workspace, chunkX, chunkY, chunkZ, numThreads,
+                [&](int) -> const Distribution& { return distribution; });
+        }
+
+        // Same as generateChunkBatch for chunk (0, 0, 0).
+        template <typename GeneratedNoiseType, typename Distribution>
+        void generateOctavesBatch(GeneratedNoiseType* generatedNoiseMaps, const long* seeds,
+            const Distribution* distributions, int count, NoiseWorkspace& workspace, int numThreads = 1) const {
+            generateChunkBatch(generatedNoiseMaps, seeds, distributions, count, workspace, 0, 0, 0, numThreads);
+        }
+
+        template <typename GeneratedNoiseType, typename Distribution = DefaultDistribution>
+        void generateOctavesBatch(GeneratedNoiseType* generatedNoiseMaps, const long* seeds, int count,
+            NoiseWorkspace& workspace, const Distribution& distribution = DefaultDistribution{0.f, 1.f},
+            int numThreads = 1) const {
+            generateChunkBatch(generatedNoiseMaps, seeds, count, workspace, 0, 0, 0, distribution, numThreads);
+        }
+
+        // Same map as generateChunk, together with its partial derivatives along x, y and z in the same pass. The
+        // derivatives are exact for the interpolated field, per element, and normalized like the map, so
+        // (-gradientX, -gradientY, 1) is a surface normal of a 2D height map. Along a flat axis, derivatives are those
+        // of the field through the chunk, so they are 0 where the map lies on a lattice point.
+        template <typename GeneratedNoiseType, typename Distribution = DefaultDistribution>
+        GeneratedNoiseType& generateChunkGradient(GeneratedNoiseType& generatedNoiseMap, GeneratedNoiseType& gradientX,
+            GeneratedNoiseType& gradientY, GeneratedNoiseType& gradientZ, NoiseWorkspace& workspace, int chunkX,
+            int chunkY, int chunkZ, Distribution&& distribution = DefaultDistribution{0.f, 1.f}, long seed = 0,
+            int numThreads = 1) const {
+            generateGradientBlocks(generatedNoiseMap.data(), gradientX.data(), gradientY.data(), gradientZ.data(),
+                workspace, chunkX, chunkY, chunkZ, distribution, seed, numThreads);
+            return generatedNoiseMap;
+        }
+
+        // Without the z derivative, for 2D maps.
+        template <typename GeneratedNoiseType, typename Distribution = DefaultDistribution>
+        GeneratedNoiseType& generateChunkGradient(GeneratedNoiseType& generatedNoiseMap, GeneratedNoiseType& gradientX,
+            GeneratedNoiseType& gradientY, NoiseWorkspace& workspace, int chunkX, int chunkY,
+            Distribution&& distribution = DefaultDistribution{0.f, 1.f}, long seed = 0, int numThreads = 1) const {
+            generateGradientBlocks(generatedNoiseMap.data(), gradientX.data(), gradientY.data(), nullptr, workspace,
+                chunkX, chunkY, 0, distribution, seed, numThreads);
+            return generatedNoiseMap;
+        }
+
+        // Same as generateChunkGradient for chunk (0, 0, 0).
+        template <typename GeneratedNoiseType, typename Distribution = DefaultDistribution>
+        GeneratedNoiseType& generateOctavesGradient(GeneratedNoiseType& generatedNoiseMap,
+            GeneratedNoiseType& gradientX, GeneratedNoiseType& gradientY, GeneratedNoiseType& gradientZ,
+            NoiseWorkspace& workspace, Distribution&& distribution = DefaultDistribution{0.f, 1.f}, long seed = 0,
+            int numThreads = 1) const {
+            return generateChunkGradient(generatedNoiseMap, gradientX, gradientY, gradientZ, workspace, 0, 0, 0,
+                std::forward<Distribution&&>(distribution), seed, numThreads);
+        }
+
+        template <typename GeneratedNoiseType, typename Distribution = DefaultDistribution>
+        GeneratedNoiseType& generateOctavesGradient(GeneratedNoiseType& generatedNoiseMap,
+            GeneratedNoiseType& gradientX, GeneratedNoiseType& gradientY, NoiseWorkspace& workspace,
+            Distribution&& distribution = DefaultDistribution{0.f, 1.f}, long seed = 0, int numThreads = 1) const {
+            return generateChunkGradient(generatedNoiseMap, gradientX, gradientY, workspace, 0, 0,
+                std::forward<Distribution&&>(distribution), seed, numThreads);
+        }
+
+        // Evaluate the noise field at count scattered positions (x[i], y[i], z[i]) and write the results to values.
+        // Positions are in the same coordinates as generateChunk: element (x, y, z) of chunk (0, 0, 0) is the element
+        // at (x, y, z) of the map generateOctaves produces, so results match the dense maps exactly, whatever the
+        // target instruction set and FP contraction setting. Positions can be int or int64_t, to reach chunks whose
+        // elements lie beyond the range of int. The cost is proportional to count. Queries are processed in
+        // fixed-size batches, one SIMD lane per query, so hashing, uniform draws and interpolation vectorize.
+        template <typename Coordinate, typename Distribution = DefaultDistribution>
+        void sample(const Coordinate* x, const Coordinate* y, const Coordinate* z, int count, float* values,
+            Distribution&& distribution = DefaultDistribution{0.f, 1.f}, long seed = 0) const {
+            static_assert(std::is_integral_v<Coordinate>, "Positions must be integers");
+            // Flat maps draw from relabeled lattices, like the dense kernels (see withMapLattice).
+            withMapLattice([&](auto lattice) {
+                using Lattice = decltype(lattice);
+                for (int begin = 0; begin < count; begin += SampleBatchSize) {
+                    const int batchSize = std::min(SampleBatchSize, count - begin);
+                    // Pad the last batch by repeating its final query.
+                    int64_t queryX[SampleBatchSize], queryY[SampleBatchSize], queryZ[SampleBatchSize];
+                    for (int i = 0; i < SampleBatchSize; ++i) {
+                        const int query = begin + std::min(i, batchSize - 1);
+                        queryX[i] = x[query];
+                        queryY[i] = y[query];
+                        queryZ[i] = z[query];
+                    }
+                    float sum[SampleBatchSize];
+                    for (int octaveIndex = 0; octaveIndex < numOctaves(); ++octaveIndex) {
+                        const Octave& octave = mOctaves[octaveIndex];
+                        const uint32_t seedKey = Lattice::seedKey(octaveSeed(seed, octaveIndex));
+                        // Find the lattice cell each query falls in and its attenuations.
+                        int cellX[SampleBatchSize], cellY[SampleBatchSize], cellZ[SampleBatchSize];
+                        float attenuationX[SampleBatchSize], attenuationY[SampleBatchSize];
+                        float attenuationZ[SampleBatchSize];
+                        for (int i = 0; i < SampleBatchSize; ++i) {
+                            cellX[i] = latticeCoordinate(queryX[i], octave.scaleX);
+                            cellY[i] = latticeCoordinate(queryY[i], octave.scaleY);
+                            cellZ[i] = latticeCoordinate(queryZ[i], octave.scaleZ);
+                            attenuationX[i] = octave.attenuationsX[latticeOffset(queryX[i], octave.scaleX)];
+                            attenuationY[i] = octave.attenuationsY[latticeOffset(queryY[i], octave.scaleY)];
+                            attenuationZ[i] = octave.attenuationsZ[latticeOffset(queryZ[i], octave.scaleZ)];
+                        }
+                        // Hash the 8 surrounding lattice points of every query, then draw them. Both loops run
+                        // across the queries of the batch, one lane per query, so hashing and the uniform draws
+                        // vectorize. The normal fast path still calls log and cos once per point.
+                        uint32_t keys[8][SampleBatchSize];
+                        for (int corner = 0; corner < 8; ++corner) {
+                            const int dx = corner & 1, dy = (corner >> 1) & 1, dz = (corner >> 2) & 1;
+                            for (int i = 0; i < SampleBatchSize; ++i) {
+                                keys[corner][i] = Lattice::pointKey(seedKey, latticeStep(cellX[i], dx),
+                                    latticeStep(cellY[i], dy), latticeStep(cellZ[i], dz));
+                            }
+                        }
+                        float corners[8][SampleBatchSize];
+                        for (int corner = 0; corner < 8; ++corner) {
+                            for (int i = 0; i < SampleBatchSize; ++i) {
+                                corners[corner][i] = latticeValue(distribution, keys[corner][i]);
+                            }
+                        }
+                        // Interpolate in the same order as the dense kernels: along Z, then Y, then X. Each step
+                        // overwrites the corners it has consumed.
+                        for (int corner = 0; corner < 4; ++corner) {
+                            interpolateQueries<std::true_type>(corners[corner], corners[corner], corners[corner + 4],
+                                attenuationZ, SampleBatchSize);
+                        }
+                        interpolateQueries<std::true_type>(corners[0], corners[0], corners[2], attenuationY,
+                            SampleBatchSize);
+                        interpolateQueries<std::true_type>(corners[1], corners[1], corners[3], attenuationY,
+                            SampleBatchSize);
+                        if (octaveIndex == 0) {
+                            interpolateQueries<std::true_type>(sum, corners[0], corners[1], attenuationX,
+                                SampleBatchSize);
+                        } else {
+                            interpolateQueries<std::false_type>(sum, corners[0], corners[1], attenuationX,
+                                SampleBatchSize, octave.multiplier);
+                        }
+                    }
+                    for (int i = 0; i < batchSize; ++i) {
+                        values[begin + i] = sum[i] / mNormalizationFactor;
+                    }
+                }
+            });
+        }
+
+        int width() const noexcept {
+            return mWidth;
+        }
+
+        int length() const noexcept {
+            return mLength;
+        }
+
+        int height() const noexcept {
+            return mHeight;
+        }
+
+        int size() const noexcept {
+            return mWidth * mLength * mHeight;
+        }
+
+        int numOctaves() const noexcept {
+            return static_cast<int>(mOctaves.size());
+        }
+
+        const std::vector<Octave>& octaves() const noexcept {
+            return mOctaves;
+        }
+
+        float normalizationFactor() const noexcept {
+            return mNormalizationFactor;
+        }
+
+        float decayFactor() const noexcept {
+            return mDecayFactor;
+        }
+
+        // Number of floats of workspace a call needs. Encoded calls also need one block of scratch per thread, and
+        // batched calls need this much for every map.
+        size_t workspaceSize() const noexcept {
+            return mWorkspaceSize;
+        }
+    private:
+        static constexpr int SampleBatchSize = 64;
+
+        // The box fillBlock fills: its width, the strides of the lattice window it reads from and the strides of
+        // the memory it writes to.
+        struct BlockLayout {
+            int width;
+            int internalRow, internalLayer;
+            int rowStride, layerStride;
+            // Distance between neighbouring lattice points of a row, the number of maps when lattices are interleaved
+            // (see fillLanes).
+            int internalColumn = 1;
+        };
+
+        // The part of an octave's lattice that a width x length x height box starting at (originX, originY, originZ)
+        // overlaps: its first lattice point, where the box starts relative to that point, and its size.
+        struct LatticeWindow {
+            int x, y, z;
+            int offsetX, offsetY, offsetZ;
+            int width, length, height;
+        };
+
+        // Lattice coordinates wrap around like the templates' (see latticeCoordinate), so any origin has a window.
+        LatticeWindow latticeWindow(const Octave& octave, int64_t originX, int64_t originY, int64_t originZ, int width,
+            int length, int height) const noexcept {
+            LatticeWindow window;
+            window.x = latticeCoordinate(originX, octave.scaleX);
+            window.y = latticeCoordinate(originY, octave.scaleY);
+            window.z = latticeCoordinate(originZ, octave.scaleZ);
+            window.offsetX = latticeOffset(originX, octave.scaleX);
+            window.offsetY = latticeOffset(originY, octave.scaleY);
+            window.offsetZ = latticeOffset(originZ, octave.scaleZ);
+            // Never larger than the octave's internal noise map, since the box fits in the engine's shape.
+            window.width = ceilDivide(window.offsetX + width, octave.scaleX) + 1;
+            window.length = latticeExtent(window.offsetY, length, octave.scaleY);
+            window.height = latticeExtent(window.offsetZ, height, octave.scaleZ);
+            return window;
+        }
+
+        // The first element of a chunk along an axis of the given size. Like the templates, origins are 64-bit, so
+        // chunks whose elements lie beyond the range of int still have one.
+        static constexpr int64_t chunkOrigin(int chunk, int size) noexcept {
+            return static_cast<int64_t>(chunk) * size;
+        }
+
+        // Lattice rows or layers that a box of size elements along y or z overlaps when it starts offset elements
+        // into a cell. A single row or layer on a lattice point only needs that point, since the next one gets a
+        // weight of exactly 0: its window has one row or layer, which fillBlock reads twice.
+        static int latticeExtent(int offset, int size, int scale) noexcept {
+            return (size == 1 && offset == 0) ? 1 : ceilDivide(offset + size, scale) + 1;
+        }
+
+        // Call func with the lattice generate draws maps of the engine's shape from (see MapLattice), which only
+        // depends on which axes are flat.
+        template <typename Function>
+        void withMapLattice(Function&& func) const {
+            switch ((mWidth == 1) + 2 * (mLength == 1) + 4 * (mHeight == 1)) {
+                case 0:
+                    return func(MapLattice<2, 2, 2>{});
+                case 1:
+                    return func(MapLattice<1, 2, 2>{});
+                case 2:
+                    return func(MapLattice<2, 1, 2>{});
+                case 3:
+                    return func(MapLattice<1, 1, 2>{});
+                case 4:
+                    return func(MapLattice<2, 2, 1>{});
+                case 5:
+                    return func(MapLattice<1, 2, 1>{});
+                case 6:
+                    return func(MapLattice<2, 1, 1>{});
+                default:
+                    return func(MapLattice<1, 1, 1>{});
+            }
+        }
+
+        // fillInternalNoiseMap from the engine's lattice (see withMapLattice).
+        template <typename Distribution>
+        void drawLattice(float* values, int width, int length, int height, long seed, const Distribution& distribution,
+            int numThreads, int originX, int originY, int originZ, int stride = 1) const {
+            withMapLattice([&](auto lattice) {
+                fillInternalNoiseMap<decltype(lattice)>(values, width, length, height, seed, distribution, numThreads,
+                    originX, originY, originZ, stride);
+            });
+        }
+
+        static std::vector<float> generateAttenuations(int scale) {
+            std::vector<float> attenuations(scale);
+            for (int i = 0; i < scale; ++i) {
+                attenuations[i] = attenuationPolynomial(i / (float) scale);
+            }
+            return attenuations;
+        }
+
+        // Chain rule: an element is 1 / scale of a tile.
+        static std::vector<float> generateAttenuationDerivatives(int scale) {
+            std::vector<float> derivatives(scale);
+            for (int i = 0; i < scale; ++i) {
+                derivatives[i] = attenuationDerivative(i / (float) scale) / scale;
+            }
+            return derivatives;
+        }
+
+        // Walk the block schedule, spreading blocks across numThreads threads. Calls
+        // func(thread, beginY, endY, beginZ, endZ) on every rectangular piece of every block.
+        template <typename Function>
+        void forEachBlock(int numThreads, Function&& func) const {
+            forEachBlock(numThreads, mRowsPerBlock, std::forward<Function>(func));
+        }
+
+        // Same with blocks of a different number of rows.
+        template <typename Function>
+        void forEachBlock(int numThreads, int rowsPerBlock, Function&& func) const {
+            const int numRows = mLength * mHeight;
+            parallelForEachThread(ceilDivide(numRows, rowsPerBlock), numThreads,
+                [&](int thread, int beginBlock, int endBlock) {
+                    for (int block = beginBlock; block < endBlock; ++block) {
+                        forEachRowBlock(block * rowsPerBlock, std::min((block + 1) * rowsPerBlock, numRows), mLength,
+                            [&](int beginY, int endY, int beginZ, int endZ) {
+                                func(thread, beginY, endY, beginZ, endZ);
+                            });
+                    }
+                });
+        }
+
+        // Draw the window of every octave's lattice that the chunk starting at (originX, originY, originZ) overlaps
+        // into internalNoiseMaps.
+        template <typename Distribution>
+        void drawChunkLattices(float* internalNoiseMaps, int64_t originX, int64_t originY, int64_t originZ,
+            const Distribution& distribution, long seed, int numThreads) const {
+            for (int i = 0; i < numOctaves(); ++i) {
+                const Octave& octave = mOctaves[i];
+                const LatticeWindow window = latticeWindow(octave, originX, originY, originZ, mWidth, mLength, mHeight);
+                PhaseTimer timer{Phase::Lattice, octave.index, octave.scaleX, octave.scaleY, octave.scaleZ, 0,
+                    (long) window.width * window.length * window.height};
+                drawLattice(internalNoiseMaps + octave.internalOffset, window.width, window.length, window.height,
+                    octaveSeed(seed, i), distribution, numThreads, window.x, window.y, window.z);
+            }
+        }
+
+        // How fillBlock reads an octave's lattice window drawn by drawChunkLattices and writes a map of the engine's
+        // shape.
+        BlockLayout chunkLayout(const LatticeWindow& window) const noexcept {
+            return BlockLayout{mWidth, (window.length == 1) ? 0 : window.width,
+                (window.height == 1) ? 0 : window.width * window.length, mWidth, mWidth * mLength};
+        }
+
+        // Draw the part of every octave's lattice that a chunk overlaps into internalNoiseMaps, then build the chunk
+        // one block at a time. Every piece of a block is contiguous in the map: it is accumulated and normalized
+        // in blockOutput(thread, offset), where offset is the index of its first element in the map, and then
+        // handed to finishBlock(block, offset, count).
+        template <typename Distribution, typename BlockOutput, typename FinishBlock>
+        void generateBlocks(float* internalNoiseMaps, int chunkX, int chunkY, int chunkZ,
+            const Distribution& distribution, long seed, int numThreads, BlockOutput&& blockOutput,
+            FinishBlock&& finishBlock) const {
+            const int64_t originX = chunkOrigin(chunkX, mWidth), originY = chunkOrigin(chunkY, mLength),
+                originZ = chunkOrigin(chunkZ, mHeight);
+            drawChunkLattices(internalNoiseMaps, originX, originY, originZ, distribution, seed, numThreads);
+            forEachBlock(numThreads, [&](int thread, int beginY, int endY, int beginZ, int endZ) {
+                const int offset = beginY * mWidth + beginZ * mWidth * mLength;
+                const int count = (endY - beginY) * (endZ - beginZ) * mWidth;
+                float* block = blockOutput(thread, offset);
+                for (int i = 0; i < numOctaves(); ++i) {
+                    const Octave& octave = mOctaves[i];
+                    const LatticeWindow window = latticeWindow(octave, originX, originY, originZ, mWidth, mLength,
+                        mHeight);
+                    const float* internalNoiseMap = internalNoiseMaps + octave.internalOffset;
+                    if (i == 0) {
+                        fillBlock<std::true_type>(octave, chunkLayout(window), internalNoiseMap, window.offsetX,
+                            window.offsetY, window.offsetZ, beginY, endY, beginZ, endZ, block);
+                    } else {
+                        fillBlock<std::false_type>(octave, chunkLayout(window), internalNoiseMap, window.offsetX,
+                            window.offsetY, window.offsetZ, beginY, endY, beginZ, endZ, block);
+                    }
+                }
+                normalizeBlock(block, count);
+                finishBlock(block, offset, count);
+            });
+        }
+
+        // Batched counterpart of generateBlocks, with one SIMD lane per map. Lattice point p of map m in octave i lives
+        // at internalNoiseMaps[octave.internalOffset * count + p * count + m], so the corners of all maps for one tile
+        // are contiguous lanes. fillLanes interpolates every element for all maps at once into an interleaved block,
+        // which is then normalized and split into the maps.
+        template <typename GeneratedNoiseType, typename DistributionFunction>
+        void generateBatch(GeneratedNoiseType* generatedNoiseMaps, const long* seeds, int count,
+            NoiseWorkspace& workspace, int chunkX, int chunkY, int chunkZ, int numThreads,
+            DistributionFunction&& distribution) const {
+            if (count < 1) {
+                return;
+            }
+            const int64_t originX = chunkOrigin(chunkX, mWidth), originY = chunkOrigin(chunkY, mLength),
+                originZ = chunkOrigin(chunkZ, mHeight);
+            // Interleaved blocks hold count maps, so they get fewer rows to stay cache-sized.
+            const int rowsPerBlock = std::max(1, FusedBlockSize / (mWidth * count));
+            // Every thread gets an interleaved block and 6 lane vectors for the corners of the current tile.
+            const size_t threadScratchSize = (static_cast<size_t>(rowsPerBlock) * mWidth + 6) * count;
+            float* internalNoiseMaps = workspace.reserve(mWorkspaceSize * count
+                + threadScratchSize * std::max(numThreads, 1));
+            float* scratch = internalNoiseMaps + mWorkspaceSize * count;
+            for (int i = 0; i < numOctaves(); ++i) {
+                const Octave& octave = mOctaves[i];
+                const LatticeWindow window = latticeWindow(octave, originX, originY, originZ, mWidth, mLength, mHeight);
+                PhaseTimer timer{Phase::Lattice, octave.index, octave.scaleX, octave.scaleY, octave.scaleZ, 0,
+                    (long) window.width * window.length * window.height * count};
+                for (int map = 0; map < count; ++map) {
+                    drawLattice(internalNoiseMaps + octave.internalOffset * count + map, window.width, window.length,
+                        window.height, octaveSeed(seeds[map], i), distribution(map), numThreads, window.x, window.y,
+                        window.z, count);
+                }
+            }
+            forEachBlock(numThreads, rowsPerBlock, [&](int thread, int beginY, int endY, int beginZ, int endZ) {
+                float* lanes = scratch + thread * threadScratchSize;
+                float* corners = lanes + static_cast<size_t>(rowsPerBlock) * mWidth * count;
+                for (int i = 0; i < numOctaves(); ++i) {
+                    const Octave& octave = mOctaves[i];
+                    const LatticeWindow window = latticeWindow(octave, originX, originY, originZ, mWidth, mLength,
+                        mHeight);
+                    const BlockLayout layout{mWidth, (window.length == 1) ? 0 : window.width * count,
+                        (window.height == 1) ? 0 : window.width * window.length * count, mWidth, mWidth * mLength,
+                        count};
+                    const float* internalNoiseMap = internalNoiseMaps + octave.internalOffset * count;
+                    if (i == 0) {
+                        fillLanes<std::true_type>(octave, layout, internalNoiseMap, window.offsetX, window.offsetY,
+                            window.offsetZ, beginY, endY, beginZ, endZ, lanes, corners, count);
+                    } else {
+                        fillLanes<std::false_type>(octave, layout, internalNoiseMap, window.offsetX, window.offsetY,
+                            window.offsetZ, beginY, endY, beginZ, endZ, lanes, corners, count);
+                    }
+                }
+                // Pieces of a block are whole layers or rows of one layer, so they are contiguous in every map.
+                const int numElements = (endY - beginY) * (endZ - beginZ) * mWidth;
+                normalizeBlock(lanes, numElements * count);
+                const int offset = beginY * mWidth + beginZ * mWidth * mLength;
+                for (int map = 0; map < count; ++map) {
+                    float* block = generatedNoiseMaps[map].data() + offset;
+                    for (int element = 0; element < numElements; ++element) {
+                        block[element] = lanes[element * count + map];
+                    }
+                }
+            });
+        }
+
+        // generateBlocks for generateChunkGradient, for all the maps at once. gradientZ may be null.
+        template <typename Distribution>
+        void generateGradientBlocks(float* output, float* gradientX, float* gradientY, float* gradientZ,
+            NoiseWorkspace& workspace, int chunkX, int chunkY, int chunkZ, const Distribution& distribution, long seed,
+            int numThreads) const {
+            const int64_t originX = chunkOrigin(chunkX, mWidth), originY = chunkOrigin(chunkY, mLength),
+                originZ = chunkOrigin(chunkZ, mHeight);
+            // The blocks of all the maps together should take up as much cache as one block of generateBlocks.
+            const int numMaps = gradientZ ? 4 : 3;
+            const int rowsPerBlock = std::max(1, mRowsPerBlock / numMaps);
+            // Value blocks are accumulated in per-thread scratch and normalized into the maps. Maps allocated
+            // separately usually start at the same offset in a page, so rows of different maps would compete for the
+            // same cache sets and make loads from one map wait on stores to another. Scratch blocks are 16 floats
+            // apart modulo a page instead.
+            const size_t mapStride = static_cast<size_t>(ceilDivide(rowsPerBlock * mWidth, 1024)) * 1024 + 256;
+            const size_t threadScratchSize = mapStride * numMaps;
+            float* internalNoiseMaps = workspace.reserve(mWorkspaceSize + threadScratchSize
+                * std::max(numThreads, 1));
+            float* scratch = internalNoiseMaps + mWorkspaceSize;
+            drawChunkLattices(internalNoiseMaps, originX, originY, originZ, distribution, seed, numThreads);
+            forEachBlock(numThreads, rowsPerBlock, [&](int thread, int beginY, int endY, int beginZ, int endZ) {
+                const int offset = beginY * mWidth + beginZ * mWidth * mLength;
+                const int count = (endY - beginY) * (endZ - beginZ) * mWidth;
+                float* const gradientBlockZ = gradientZ ? gradientZ + offset : nullptr;
+                // Pieces of a block are whole layers or rows of one layer, so they are contiguous in every map.
+                float* const block = scratch + thread * threadScratchSize;
+                float* const blockX = block + mapStride;
+                float* const blockY = blockX + mapStride;
+                float* const blockZ = gradientZ ? blockY + mapStride : nullptr;
+                for (int i = 0; i < numOctaves(); ++i) {
+                    const Octave& octave = mOctaves[i];
+                    const LatticeWindow window = latticeWindow(octave, originX, originY, originZ, mWidth, mLength,
+                        mHeight);
+                    const float* internalNoiseMap = internalNoiseMaps + octave.internalOffset;
+                    // The attenuations of octaves with a scale of 1 are flat at every element, so once the scales
+                    // along every derivative are 1, octaves only add to the values.
+                    const bool withGradient = octave.scaleX > 1 || octave.scaleY > 1 || (blockZ && octave.scaleZ > 1);
+                    if (i == 0) {
+                        fillGradientBlock<std::true_type>(octave, chunkLayout(window), internalNoiseMap,
+                            window.offsetX, window.offsetY, window.offsetZ, beginY, endY, beginZ, endZ, block,
+                            blockX, blockY, blockZ);
+                    } else if (withGradient) {
+                        fillGradientBlock<std::false_type>(octave, chunkLayout(window), internalNoiseMap,
+                            window.offsetX, window.offsetY, window.offsetZ, beginY, endY, beginZ, endZ, block,
+                            blockX, blockY, blockZ);
+                    } else {
+                        fillBlock<std::false_type>(octave, chunkLayout(window), internalNoiseMap, window.offsetX,
+                            window.offsetY, window.offsetZ, beginY, endY, beginZ, endZ, block);
+                    }
+                }
+                normalizeBlock(block, count, output + offset);
+                normalizeBlock(blockX, count, gradientX + offset);
+                normalizeBlock(blockY, count, gradientY + offset);
+                if (gradientBlockZ) {
+                    normalizeBlock(blockZ, count, gradientBlockZ);
+                }
+            });
+        }
+
+        // Accumulate and normalize a box whose lattice windows (see latticeWindow) have already been drawn.
+        // lattice(i) returns the first point of octave i's window.
+        template <typename LatticeFunction>
+        void interpolateRegion(float* output, int rowStride, int layerStride, int64_t originX, int64_t originY,
+            int64_t originZ, int width, int length, int height, int numThreads, LatticeFunction&& lattice) const {
+            accumulateRegion(output, rowStride, layerStride, width, length, height, numThreads,
+                [&](int beginY, int endY, int beginZ, int endZ, float* block) {
+                    for (int i = 0; i < numOctaves(); ++i) {
+                        const Octave& octave = mOctaves[i];
+                        const LatticeWindow window = latticeWindow(octave, originX, originY, originZ, width, length,
+                            height);
+                        const BlockLayout layout{width, (window.length == 1) ? 0 : window.width,
+                            (window.height == 1) ? 0 : window.width * window.length, rowStride, layerStride};
+                        if (i == 0) {
+                            fillBlock<std::true_type>(octave, layout, lattice(i), window.offsetX, window.offsetY,
+                                window.offsetZ, beginY, endY, beginZ, endZ, block);
+                        } else {
+                            fillBlock<std::false_type>(octave, layout, lattice(i), window.offsetX, window.offsetY,
+                                window.offsetZ, beginY, endY, beginZ, endZ, block);
+                        }
+                    }
+                });
+        }
+
+        // Walk a width x length x height box in cache-sized blocks of rows, like generateChunk. Every octave is
+        // accumulated into a block by fillOctaves(beginY, endY, beginZ, endZ, block), where block is the box's
+        // element (0, beginY, beginZ), and the block is then normalized.
+        template <typename FillOctaves>
+        void accumulateRegion(float* output, int rowStride, int layerStride, int width, int length, int height,
+            int numThreads, FillOctaves&& fillOctaves) const {
+            const int rowsPerBlock = std::max(1, FusedBlockSize / width);
+            const int numRows = length * height;
+            parallelFor(ceilDivide(numRows, rowsPerBlock), numThreads, [&](int beginBlock, int endBlock) {
+                for (int blockIndex = beginBlock; blockIndex < endBlock; ++blockIndex) {
+                    forEachRowBlock(blockIndex * rowsPerBlock, std::min((blockIndex + 1) * rowsPerBlock, numRows),
+                        length, [&](int beginY, int endY, int beginZ, int endZ) {
+                            float* block = output + beginY * rowStride + beginZ * layerStride;
+                            fillOctaves(beginY, endY, beginZ, endZ, block);
+                            PhaseTimer timer{Phase::Normalization, -1, 0, 0, 0,
+                                (long) (endY - beginY) * (endZ - beginZ) * width};
+                            for (int z = 0; z < endZ - beginZ; ++z) {
+                                for (int y = 0; y < endY - beginY; ++y) {
+                                    divideRow(block + y * rowStride + z * layerStride, width, mNormalizationFactor);
+                                }
+                            }
+                        });
+                }
+            });
+        }
+
+        // The time scale of the octave after one with scaleT. Halving stops at 2: at 1, every frame would be a lattice
+        // point and draw new slices.
+        static constexpr int nextTimeScale(int scaleT) {
+            return scaleT > 2 ? ceilDivide(scaleT, 2) : scaleT;
+        }
+
+        // Bring one octave's lattice time slices up to frame and blend them into lattice, which holds windowSize
+        // points. Missing slices are drawn with drawSlice(values, slice); slices the previous frame already drew are
+        // kept.
+        template <typename DrawSlice>
+        static void blendTimeSlices(NoiseTimeCache& cache, const Octave& octave, NoiseTimeCache::Slices& slices,
+            int frame, int scaleT, size_t windowSize, float* lattice, DrawSlice&& drawSlice) {
+            const auto draw = [&](std::vector<float>& values, int slice) {
+                PhaseTimer timer{Phase::Lattice, octave.index, octave.scaleX, octave.scaleY, octave.scaleZ, 0,
+                    (long) windowSize};
+                drawSlice(cache.draw(values, windowSize), slice);
+            };
+            const int slice = floorDivide(frame, scaleT);
+            if (slices.valid && slice == slices.firstSlice + 1) {
+                std::swap(slices.first, slices.second);
+                draw(slices.second, slice + 1);
+            } else if (slices.valid && slice == slices.firstSlice - 1) {
+                std::swap(slices.first, slices.second);
+                draw(slices.first, slice);
+            } else if (!slices.valid || slice != slices.firstSlice) {
+                draw(slices.first, slice);
+                draw(slices.second, slice + 1);
+            }
+            slices.firstSlice = slice;
+            slices.valid = true;
+            // Interpolation is linear in the lattice values, so blending the slices here is the same as blending
+            // two interpolated maps. The blend builds the octave's lattice, so it is timed with the draws.
+            PhaseTimer timer{Phase::Lattice, octave.index, octave.scaleX, octave.scaleY, octave.scaleZ, 0,
+                (long) windowSize};
+            const float weight = attenuationPolynomial((frame - slice * scaleT) / (float) scaleT);
+            for (size_t j = 0; j < windowSize; ++j) {
+                lattice[j] = slices.first[j] + rounded(weight * (slices.second[j] - slices.first[j]));
+            }
+        }
+
+        // The high octaves are made of very short rows. Give the row kernel a constant length for the common
+        // short sizes so that it is as tight as the compile-time path.
+        template <typename overwrite>
+        static void interpolateTileRow(float* row, const float* attenuations, int count, float left, float right,
+            float multiplier) noexcept {
+            switch (count) {
+                case 2:
+                    return interpolateRow<overwrite>(row, attenuations, 2, left, right, multiplier);
+                case 4:
+                    return interpolateRow<overwrite>(row, attenuations, 4, left, right, multiplier);
+                case 8:
+                    return interpolateRow<overwrite>(row, attenuations, 8, left, right, multiplier);
+                case 16:
+                    return interpolateRow<overwrite>(row, attenuations, 16, left, right, multiplier);
+                default:
+                    return interpolateRow<overwrite>(row, attenuations, count, left, right, multiplier);
+            }
+        }
+
+        // interpolateTileRow for interpolateGradientRow.
+        template <typename overwrite, bool withZ>
+        static void interpolateGradientTileRow(float* row, float* gradientX, float* gradientY, float* gradientZ,
+            const float* attenuations, const float* derivatives, int count, float left, float right, float multiplier,
+            float slopeX, float startY, float slopeY, float startZ, float slopeZ) noexcept {
+            switch (count) {
+                case 2:
+                    return interpolateGradientRow<overwrite, withZ>(row, gradientX, gradientY, gradientZ, attenuations,
+                        derivatives, 2, left, right, multiplier, slopeX, startY, slopeY, startZ, slopeZ);
+                case 4:
+                    return interpolateGradientRow<overwrite, withZ>(row, gradientX, gradientY, gradientZ, attenuations,
+                        derivatives, 4, left, right, multiplier, slopeX, startY, slopeY, startZ, slopeZ);
+                case 8:
+                    return interpolateGradientRow<overwrite, withZ>(row, gradientX, gradientY, gradientZ, attenuations,
+                        derivatives, 8, left, right, multiplier, slopeX, startY, slopeY, startZ, slopeZ);
+                case 16:
+                    return interpolateGradientRow<overwrite, withZ>(row, gradientX, gradientY, gradientZ, attenuations,
+                        derivatives, 16, left, right, multiplier, slopeX, startY, slopeY, startZ, slopeZ);
+                default:
+                    return interpolateGradientRow<overwrite, withZ>(row, gradientX, gradientY, gradientZ, attenuations,
+                        derivatives, count, left, right, multiplier, slopeX, startY, slopeY, startZ, slopeZ);
+            }
+        }
+
+        // fillBlock for generateBatch, on count interleaved maps: element e of map m is lanes[e * count + m], with
+        // layout.rowStride and layout.layerStride counted in elements. Every interpolation runs on all maps at once.
+        // corners holds 6 lane vectors of scratch.
+        template <typename overwrite>
+        void fillLanes(const Octave& octave, const BlockLayout& layout, const float* internalNoiseMap, int offsetX,
+            int offsetY, int offsetZ, int beginY, int endY, int beginZ, int endZ, float* lanes, float* corners,
+            int count) const {
+            PhaseTimer timer{Phase::Interpolation, octave.index, octave.scaleX, octave.scaleY, octave.scaleZ,
+                (long) (endY - beginY) * (endZ - beginZ) * layout.width * count};
+            const int width = layout.width, internalRow = layout.internalRow, internalLayer = layout.internalLayer;
+            const int internalColumn = layout.internalColumn;
+            float* topLeft = corners;
+            float* topRight = topLeft + count;
+            float* bottomLeft = topRight + count;
+            float* bottomRight = bottomLeft + count;
+            float* left = bottomRight + count;
+            float* right = left + count;
+            for (int k = (beginZ + offsetZ) / octave.scaleZ; k * octave.scaleZ - offsetZ < endZ; ++k) {
+                // Only fill the layers of this tile that fall inside the requested block.
+                const int fillStartZ = k * octave.scaleZ - offsetZ;
+                const int tileBeginZ = std::max(beginZ - fillStartZ, 0);
+                const int tileEndZ = std::min(endZ - fillStartZ, octave.scaleZ);
+                for (int j = (beginY + offsetY) / octave.scaleY; j * octave.scaleY - offsetY < endY; ++j) {
+                    const int fillStartY = j * octave.scaleY - offsetY;
+                    const int tileBeginY = std::max(beginY - fillStartY, 0);
+                    const int tileEndY = std::min(endY - fillStartY, octave.scaleY);
+                    for (int i = 0; i * octave.scaleX - offsetX < width; ++i) {
+                        const int fillStartX = i * octave.scaleX - offsetX;
+                        const int tileBeginX = std::max(-fillStartX, 0);
+                        const int tileEndX = std::min(width - fillStartX, octave.scaleX);
+                        const float* topLeft0 = internalNoiseMap + i * internalColumn + j * internalRow
+                            + k * internalLayer;
+                        const float* topRight0 = topLeft0 + internalColumn;
+                        const float* bottomLeft0 = topLeft0 + internalRow;
+                        const float* bottomRight0 = bottomLeft0 + internalColumn;
+                        float* layer = lanes + (static_cast<size_t>(fillStartX + tileBeginX)
+                            + (fillStartY + tileBeginY - beginY) * layout.rowStride
+                            + (fillStartZ + tileBeginZ - beginZ) * layout.layerStride) * count;
+                        for (int z = tileBeginZ; z < tileEndZ; ++z) {
+                            const float attenuationZ = octave.attenuationsZ[z];
+                            interpolateLanes<std::true_type>(topLeft, topLeft0, topLeft0 + internalLayer, count,
+                                attenuationZ);
+                            interpolateLanes<std::true_type>(topRight, topRight0, topRight0 + internalLayer, count,
+                                attenuationZ);
+                            interpolateLanes<std::true_type>(bottomLeft, bottomLeft0, bottomLeft0 + internalLayer,
+                                count, attenuationZ);
+                            interpolateLanes<std::true_type>(bottomRight, bottomRight0, bottomRight0 + internalLayer,
+                                count, attenuationZ);
+                            float* row = layer;
+                            for (int y = tileBeginY; y < tileEndY; ++y) {
+                                const float attenuationY = octave.attenuationsY[y];
+                                interpolateLanes<std::true_type>(left, topLeft, bottomLeft, count, attenuationY);
+                                interpolateLanes<std::true_type>(right, topRight, bottomRight, count, attenuationY);
+                                float* element = row;
+                                for (int x = tileBeginX; x < tileEndX; ++x) {
+                                    interpolateLanes<overwrite>(element, left, right, count, octave.attenuationsX[x],
+                                        octave.multiplier);
+                                    element += count;
+                                }
+                                row += static_cast<size_t>(layout.rowStride) * count;
+                            }
+                            layer += static_cast<size_t>(layout.layerStride) * count;
+                        }
+                    }
+                }
+            }
+        }
+
+        // Runtime version of fillBlock3D/fillCube for one octave, writing to a block that starts at element
+        // (0, beginY, beginZ) of the box being generated. Lattice rows and layers that do not exist in lower
+        // dimensional maps are read as the same row or layer again, which interpolates exactly.
+        template <typename overwrite>
+        void fillBlock(const Octave& octave, const BlockLayout& layout, const float* internalNoiseMap, int offsetX,
+            int offsetY, int offsetZ, int beginY, int endY, int beginZ, int endZ, float* output) const {
+            PhaseTimer timer{Phase::Interpolation, octave.index, octave.scaleX, octave.scaleY, octave.scaleZ,
+                (long) (endY - beginY) * (endZ - beginZ) * layout.width};
+            const int width = layout.width, internalRow = layout.internalRow, internalLayer = layout.internalLayer;
+            for (int k = (beginZ + offsetZ) / octave.scaleZ; k * octave.scaleZ - offsetZ < endZ; ++k) {
+                // Only fill the layers of this tile that fall inside the requested block.
+                const int fillStartZ = k * octave.scaleZ - offsetZ;
+                const int tileBeginZ = std::max(beginZ - fillStartZ, 0);
+                const int tileEndZ = std::min(endZ - fillStartZ, octave.scaleZ);
+                for (int j = (beginY + offsetY) / octave.scaleY; j * octave.scaleY - offsetY < endY; ++j) {
+                    const int fillStartY = j * octave.scaleY - offsetY;
+                    const int tileBeginY = std::max(beginY - fillStartY, 0);
+                    const int tileEndY = std::min(endY - fillStartY, octave.scaleY);
+                    for (int i = 0; i * octave.scaleX - offsetX < width; ++i) {
+                        const int fillStartX = i * octave.scaleX - offsetX;
+                        const int tileBeginX = std::max(-fillStartX, 0);
+                        const int tileEndX = std::min(width - fillStartX, octave.scaleX);
+                        // Cache noise values
+                        const float* topLeft0 = internalNoiseMap + i + j * internalRow + k * internalLayer;
+                        const float* bottomLeft0 = topLeft0 + internalRow;
+                        const float* topLeft1 = topLeft0 + internalLayer;
+                        const float* bottomLeft1 = bottomLeft0 + internalLayer;
+                        // Loop over one interpolation kernel tile.
+                        float* layer = output + (fillStartX + tileBeginX)
+                            + (fillStartY + tileBeginY - beginY) * layout.rowStride
+                            + (fillStartZ + tileBeginZ - beginZ) * layout.layerStride;
+                        for (int z = tileBeginZ; z < tileEndZ; ++z) {
+                            const float attenuationZ = octave.attenuationsZ[z];
+                            const float topLeft = interpolate1D(topLeft0[0], topLeft1[0], attenuationZ);
+                            const float topRight = interpolate1D(topLeft0[1], topLeft1[1], attenuationZ);
+                            const float bottomLeft = interpolate1D(bottomLeft0[0], bottomLeft1[0], attenuationZ);
+                            const float bottomRight = interpolate1D(bottomLeft0[1], bottomLeft1[1], attenuationZ);
+                            float* row = layer;
+                            for (int y = tileBeginY; y < tileEndY; ++y) {
+                                const float attenuationY = octave.attenuationsY[y];
+                                interpolateTileRow<overwrite>(row, octave.attenuationsX.data() + tileBeginX,
+                                    tileEndX - tileBeginX, interpolate1D(topLeft, bottomLeft, attenuationY),
+                                    interpolate1D(topRight, bottomRight, attenuationY), octave.multiplier);
+                                row += layout.rowStride;
+                            }
+                            layer += layout.layerStride;
+                        }
+                    }
+                }
+            }
+        }
+
+        // fillBlock that also accumulates the partial derivatives of every element. Along x, a row changes by
+        // (right - left) * derivativeX. Along y and z, the corners' derivatives are interpolated like the corners
+        // themselves. Each row and its derivatives come from one fused kernel (see interpolateGradientRow).
+        // gradientZ may be null.
+        template <typename overwrite>
+        void fillGradientBlock(const Octave& octave, const BlockLayout& layout, const float* internalNoiseMap,
+            int offsetX, int offsetY, int offsetZ, int beginY, int endY, int beginZ, int endZ, float* output,
+            float* gradientX, float* gradientY, float* gradientZ) const {
+            PhaseTimer timer{Phase::Interpolation, octave.index, octave.scaleX, octave.scaleY, octave.scaleZ,
+                (long) (endY - beginY) * (endZ - beginZ) * layout.width};
+            const int width = layout.width, internalRow = layout.internalRow, internalLayer = layout.internalLayer;
+            for (int k = (beginZ + offsetZ) / octave.scaleZ; k * octave.scaleZ - offsetZ < endZ; ++k) {
+                const int fillStartZ = k * octave.scaleZ - offsetZ;
+                const int tileBeginZ = std::max(beginZ - fillStartZ, 0);
+                const int tileEndZ = std::min(endZ - fillStartZ, octave.scaleZ);
+                for (int j = (beginY + offsetY) / octave.scaleY; j * octave.scaleY - offsetY < endY; ++j) {
+                    const int fillStartY = j * octave.scaleY - offsetY;
+                    const int tileBeginY = std::max(beginY - fillStartY, 0);
+                    const int tileEndY = std::min(endY - fillStartY, octave.scaleY);
+                    for (int i = 0; i * octave.scaleX - offsetX < width; ++i) {
+                        const int fillStartX = i * octave.scaleX - offsetX;
+                        const int tileBeginX = std::max(-fillStartX, 0);
+                        const int tileEndX = std::min(width - fillStartX, octave.scaleX);
+                        const int tileWidth = tileEndX - tileBeginX;
+                        const float* attenuationsX = octave.attenuationsX.data() + tileBeginX;
+                        const float* derivativesX = octave.derivativesX.data() + tileBeginX;
+                        // Cache noise values
+                        const float* topLeft0 = internalNoiseMap + i + j * internalRow + k * internalLayer;
+                        const float* bottomLeft0 = topLeft0 + internalRow;
+                        const float* topLeft1 = topLeft0 + internalLayer;
+                        const float* bottomLeft1 = bottomLeft0 + internalLayer;
+                        const int tileOffset = (fillStartX + tileBeginX)
+                            + (fillStartY + tileBeginY - beginY) * layout.rowStride
+                            + (fillStartZ + tileBeginZ - beginZ) * layout.layerStride;
+                        for (int z = tileBeginZ; z < tileEndZ; ++z) {
+                            const float attenuationZ = octave.attenuationsZ[z];
+                            const float derivativeZ = octave.derivativesZ[z];
+                            const float topLeft = interpolate1D(topLeft0[0], topLeft1[0], attenuationZ);
+                            const float topRight = interpolate1D(topLeft0[1], topLeft1[1], attenuationZ);
+                            const float bottomLeft = interpolate1D(bottomLeft0[0], bottomLeft1[0], attenuationZ);
+                            const float bottomRight = interpolate1D(bottomLeft0[1], bottomLeft1[1], attenuationZ);
+                            const float topLeftZ = (topLeft1[0] - topLeft0[0]) * derivativeZ;
+                            const float topRightZ = (topLeft1[1] - topLeft0[1]) * derivativeZ;
+                            const float bottomLeftZ = (bottomLeft1[0] - bottomLeft0[0]) * derivativeZ;
+                            const float bottomRightZ = (bottomLeft1[1] - bottomLeft0[1]) * derivativeZ;
+                            int rowOffset = tileOffset + (z - tileBeginZ) * layout.layerStride;
+                            for (int y = tileBeginY; y < tileEndY; ++y) {
+                                const float attenuationY = octave.attenuationsY[y];
+                                const float derivativeY = octave.derivativesY[y];
+                                const float left = interpolate1D(topLeft, bottomLeft, attenuationY);
+                                const float right = interpolate1D(topRight, bottomRight, attenuationY);
+                                const float leftY = rounded((bottomLeft - topLeft) * derivativeY);
+                                const float rightY = rounded((bottomRight - topRight) * derivativeY);
+                                const float slopeX = rounded((right - left) * octave.multiplier);
+                                const float startY = rounded(leftY * octave.multiplier);
+                                const float slopeY = rounded((rightY - leftY) * octave.multiplier);
+                                if (gradientZ) {
+                                    const float leftZ = interpolate1D(topLeftZ, bottomLeftZ, attenuationY);
+                                    const float rightZ = interpolate1D(topRightZ, bottomRightZ, attenuationY);
+                                    interpolateGradientTileRow<overwrite, true>(output + rowOffset,
+                                        gradientX + rowOffset, gradientY + rowOffset, gradientZ + rowOffset,
+                                        attenuationsX, derivativesX, tileWidth, left, right, octave.multiplier,
+                                        slopeX, startY, slopeY, rounded(leftZ * octave.multiplier),
+                                        rounded((rightZ - leftZ) * octave.multiplier));
+                                } else {
+                                    interpolateGradientTileRow<overwrite, false>(output + rowOffset,
+                                        gradientX + rowOffset, gradientY + rowOffset, nullptr, attenuationsX,
+                                        derivativesX, tileWidth, left, right, octave.multiplier, slopeX, startY,
+                                        slopeY, 0.0f, 0.0f);
+                                }
+                                rowOffset += layout.rowStride;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        void normalizeBlock(float* block, int count) const {
+            normalizeBlock(block, count, block);
+        }
+
+        // Normalize a block into output, which may be the block itself.
+        void normalizeBlock(const float* block, int count, float* output) const {
+            PhaseTimer timer{Phase::Normalization, -1, 0, 0, 0, count};
+            divideRow(block, count, mNormalizationFactor, output);
+        }
+
+        int mWidth, mLength, mHeight;
+        float mDecayFactor;
+        int mRowsPerBlock = 0, mNumBlocks = 0;
+        std::vector<Octave> mOctaves;
+        float mNormalizationFactor = 0.0f;
+        size_t mWorkspaceSize = 0;
+    };
+} /* Stealth::Noise */
+
+#endif /* end of include guard: NOISE_ENGINE_H */
@@ -0,0 +1,526 @@
+#ifndef NOISE_EXPRESSION_H
+#define NOISE_EXPRESSION_H
+#include "NoiseEngine.hpp"
+#include "Internal.hpp"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Expressions combine noise fields element by element, for example a ridged field times a mask plus a domain
+// warped field. NoiseExpression::evaluate walks the output one cache-sized block at a time and evaluates the whole
+// expression on each block, so only the final map is ever stored, never the fields it is made of. Maps made by the
+// templated generators are the exception: they can only join an expression as a whole, already generated map.
+namespace Stealth::Noise {
+    // Scratch memory for evaluating an expression on one thread. Buffers are reused across blocks.
+    class ExpressionScratch {
+    public:
+        // A buffer of at least size floats that stays valid until the matching release.
+        float* acquire(size_t size) {
+            if (mDepth == mBuffers.size()) {
+                mBuffers.emplace_back();
+            }
+            std::vector<float>& buffer = mBuffers[mDepth++];
+            if (buffer.size() < size) {
+                buffer.resize(size);
+            }
+            return buffer.data();
+        }
+
+        // Release the buffer acquired most recently.
+        void release() noexcept {
+            --mDepth;
+        }
+
+        // The same for integer coordinates.
+        int* acquireCoordinates(size_t size) {
+            if (mCoordinateDepth == mCoordinates.size()) {
+                mCoordinates.emplace_back();
+            }
+            std::vector<int>& buffer = mCoordinates[mCoordinateDepth++];
+            if (buffer.size() < size) {
+                buffer.resize(size);
+            }
+            return buffer.data();
+        }
+
+        void releaseCoordinates() noexcept {
+            --mCoordinateDepth;
+        }
+
+        NoiseWorkspace& workspace() noexcept {
+            return mWorkspace;
+        }
+    private:
+        std::vector<std::vector<float>> mBuffers;
+        std::vector<std::vector<int>> mCoordinates;
+        size_t mDepth = 0, mCoordinateDepth = 0;
+        NoiseWorkspace mWorkspace{};
+    };
+
+    // One node of an expression. Nodes can evaluate either a dense box, with element (x, y, z) of the box at
+    // values[x + y * width + z * width * length], or a list of scattered elements. Coordinates are those of
+    // NoiseEngine::generateChunk.
+    class ExpressionNode {
+    public:
+        virtual ~ExpressionNode() = default;
+
+        virtual void evaluateBox(float* values, int originX, int originY, int originZ, int width, int length,
+            int height, ExpressionScratch& scratch) const = 0;
+
+        virtual void evaluatePoints(float* values, const int* x, const int* y, const int* z, int count,
+            ExpressionScratch& scratch) const = 0;
+    };
+
+    // Node types behind NoiseExpression. They are used by inline functions with external linkage, so they must
+    // not have internal linkage themselves.
+    namespace detail {
+        class ConstantNode final : public ExpressionNode {
+        public:
+            explicit ConstantNode(float value) : mValue{value} { }
+
+            void evaluateBox(float* values, int, int, int, int width, int length, int height,
+                ExpressionScratch&) const override {
+                std::fill_n(values, static_cast<size_t>(width) * length * height, mValue);
+            }
+
+            void evaluatePoints(float* values, const int*, const int*, const int*, int count,
+                ExpressionScratch&) const override {
+                std::fill_n(values, count, mValue);
+            }
+        private:
+            const float mValue;
+        };
+
+        // The infinite field of a NoiseEngine. Boxes larger than the engine's shape are generated in pieces.
+        template <typename Distribution>
+        class FieldNode final : public ExpressionNode {
+        public:
+            FieldNode(const NoiseEngine& engine, Distribution distribution, long seed) : mEngine{engine},
+                mDistribution{std::move(distribution)}, mSeed{seed} { }
+
+            void evaluateBox(float* values, int originX, int originY, int originZ, int width, int length,
+                int height, ExpressionScratch& scratch) const override {
+                for (int z = 0; z < height; z += mEngine.height()) {
+                    for (int y = 0; y < length; y += mEngine.length()) {
+                        for (int x = 0; x < width; x += mEngine.width()) {
+                            mEngine.generateRegion(values + x + y * width + z * width * length, width, width * length,
+                                scratch.workspace(), originX + x, originY + y, originZ + z,
+                                std::min(mEngine.width(), width - x), std::min(mEngine.length(), length - y),
+                                std::min(mEngine.height(), height - z), mDistribution, mSeed);
+                        }
+                    }
+                }
+            }
+
+            void evaluatePoints(float* values, const int* x, const int* y, const int* z, int count,
+                ExpressionScratch&) const override {
+                mEngine.sample(x, y, z, count, values, mDistribution, mSeed);
+            }
+        private:
+            const NoiseEngine& mEngine;
+            const Distribution mDistribution;
+            const long mSeed;
+        };
+
+        // A map that already exists, such as the output of generateOctaves. Elements outside the map repeat its
+        // nearest edge.
+        class MapNode final : public ExpressionNode {
+        public:
+            MapNode(const float* values, int width, int length, int height) : mValues{values}, mWidth{width},
+                mLength{length}, mHeight{height} { }
+
+            void evaluateBox(float* values, int originX, int originY, int originZ, int width, int length,
+                int height, ExpressionScratch&) const override {
+                for (int z = 0; z < height; ++z) {
+                    for (int y = 0; y < length; ++y) {
+                        const float* row = mValues + clampedIndex(0, originY + y, originZ + z);
+                        float* output = values + y * width + z * width * length;
+                        for (int x = 0; x < width; ++x) {
+                            output[x] = row[std::min(std::max(originX + x, 0), mWidth - 1)];
+                        }
+                    }
+                }
+            }
+
+            void evaluatePoints(float* values, const int* x, const int* y, const int* z, int count,
+                ExpressionScratch&) const override {
+                for (int i = 0; i < count; ++i) {
+                    values[i] = mValues[clampedIndex(x[i], y[i], z[i])];
+                }
+            }
+        private:
+            size_t clampedIndex(int x, int y, int z) const noexcept {
+                return std::min(std::max(x, 0), mWidth - 1)
+                    + static_cast<size_t>(std::min(std::max(y, 0), mLength - 1)) * mWidth
+                    + static_cast<size_t>(std::min(std::max(z, 0), mHeight - 1)) * mWidth * mLength;
+            }
+
+            const float* mValues;
+            const int mWidth, mLength, mHeight;
+        };
+
+        enum class BinaryOperation {
+            Add,
+            Subtract,
+            Multiply,
+            Divide,
+            Minimum,
+            Maximum
+        };
+
+        class BinaryNode final : public ExpressionNode {
+        public:
+            BinaryNode(BinaryOperation operation, std::shared_ptr<const ExpressionNode> left,
+                std::shared_ptr<const ExpressionNode> right) : mOperation{operation}, mLeft{std::move(left)},
+                mRight{std::move(right)} { }
+
+            void evaluateBox(float* values, int originX, int originY, int originZ, int width, int length,
+                int height, ExpressionScratch& scratch) const override {
+                const size_t count = static_cast<size_t>(width) * length * height;
+                mLeft->evaluateBox(values, originX, originY, originZ, width, length, height, scratch);
+                float* right = scratch.acquire(count);
+                mRight->evaluateBox(right, originX, originY, originZ, width, length, height, scratch);
+                combine(values, right, count);
+                scratch.release();
+            }
+
+            void evaluatePoints(float* values, const int* x, const int* y, const int* z, int count,
+                ExpressionScratch& scratch) const override {
+                mLeft->evaluatePoints(values, x, y, z, count, scratch);
+                float* right = scratch.acquire(count);
+                mRight->evaluatePoints(right, x, y, z, count, scratch);
+                combine(values, right, count);
+                scratch.release();
+            }
+        private:
+            void combine(float* values, const float* right, size_t count) const noexcept {
+                switch (mOperation) {
+                    case BinaryOperation::Add:
+                        return apply(values, right, count, [](float a, float b) { return a + b; });
+                    case BinaryOperation::Subtract:
+                        return apply(values, right, count, [](float a, float b) { return a - b; });
+                    case BinaryOperation::Multiply:
+                        return apply(values, right, count, [](float a, float b) { return a * b; });
+                    case BinaryOperation::Divide:
+                        return apply(values, right, count, [](float a, float b) { return a / b; });
+                    case BinaryOperation::Minimum:
+                        return apply(values, right, count, [](float a, float b) { return std::min(a, b); });
+                    case BinaryOperation::Maximum:
+                        return apply(values, right, count, [](float a, float b) { return std::max(a, b); });
+                }
+            }
+
+            template <typename Function>
+            static void apply(float* values, const float* right, size_t count, Function&& func) noexcept {
+                for (size_t i = 0; i < count; ++i) {
+                    values[i] = func(values[i], right[i]);
+                }
+            }
+
+            const BinaryOperation mOperation;
+            const std::shared_ptr<const ExpressionNode> mLeft, mRight;
+        };
+
+        // Applies func to every value of its operand.
+        template <typename Function>
+        class UnaryNode final : public ExpressionNode {
+        public:
+            UnaryNode(std::shared_ptr<const ExpressionNode> operand, Function func) : mOperand{std::move(operand)},
+                mFunction{std::move(func)} { }
+
+            void evaluateBox(float* values, int originX, int originY, int originZ, int width, int length,
+                int height, ExpressionScratch& scratch) const override {
+                mOperand->evaluateBox(values, originX, originY, originZ, width, length, height, scratch);
+                apply(values, static_cast<size_t>(width) * length * height);
+            }
+
+            void evaluatePoints(float* values, const int* x, const int* y, const int* z, int count,
+                ExpressionScratch& scratch) const override {
+                mOperand->evaluatePoints(values, x, y, z, count, scratch);
+                apply(values, count);
+            }
+        private:
+            void apply(float* values, size_t count) const noexcept {
+                for (size_t i = 0; i < count; ++i) {
+                    values[i] = mFunction(values[i]);
+                }
+            }
+
+            const std::shared_ptr<const ExpressionNode> mOperand;
+            const Function mFunction;
+        };
+
+        // Evaluates source at every element moved by amplitude times the offset fields. Moved positions fall
+        // between elements, so the source is evaluated at the elements around them and interpolated linearly,
+        // like the octaves interpolate their lattices. Axes without an offset field are not interpolated.
+        class WarpNode final : public ExpressionNode {
+        public:
+            WarpNode(std::shared_ptr<const ExpressionNode> source, std::shared_ptr<const ExpressionNode> offsetX,
+                std::shared_ptr<const ExpressionNode> offsetY, std::shared_ptr<const ExpressionNode> offsetZ,
+                float amplitude) : mSource{std::move(source)}, mOffsetX{std::move(offsetX)},
+                mOffsetY{std::move(offsetY)}, mOffsetZ{std::move(offsetZ)}, mAmplitude{amplitude} { }
+
+            void evaluateBox(float* values, int originX, int originY, int originZ, int width, int length,
+                int height, ExpressionScratch& scratch) const override {
+                const int count = width * length * height;
+                int* x = scratch.acquireCoordinates(count);
+                int* y = scratch.acquireCoordinates(count);
+                int* z = scratch.acquireCoordinates(count);
+                int i = 0;
+                for (int k = 0; k < height; ++k) {
+                    for (int j = 0; j < length; ++j) {
+                        for (int column = 0; column < width; ++column, ++i) {
+                            x[i] = originX + column;
+                            y[i] = originY + j;
+                            z[i] = originZ + k;
+                        }
+                    }
+                }
+                warp(values, x, y, z, count, scratch, [&](const std::shared_ptr<const ExpressionNode>& offset,
+                    float* offsets) {
+                    offset->evaluateBox(offsets, originX, originY, originZ, width, length, height, scratch);
+                });
+                scratch.releaseCoordinates();
+                scratch.releaseCoordinates();
+                scratch.releaseCoordinates();
+            }
+
+            void evaluatePoints(float* values, const int* x, const int* y, const int* z, int count,
+                ExpressionScratch& scratch) const override {
+                int* warpedX = scratch.acquireCoordinates(count);
+                int* warpedY = scratch.acquireCoordinates(count);
+                int* warpedZ = scratch.acquireCoordinates(count);
+                std::copy_n(x, count, warpedX);
+                std::copy_n(y, count, warpedY);
+                std::copy_n(z, count, warpedZ);
+                warp(values, warpedX, warpedY, warpedZ, count, scratch, [&](
+                    const std::shared_ptr<const ExpressionNode>& offset, float* offsets) {
+                    offset->evaluatePoints(offsets, x, y, z, count, scratch);
+                });
+                scratch.releaseCoordinates();
+                scratch.releaseCoordinates();
+                scratch.releaseCoordinates();
+            }
+        private:
+            // Move the positions (x, y, z) by the offsets evaluateOffset(offset, offsets) computes for them, then
+            // evaluate the source there.
+            template <typename EvaluateOffset>
+            void warp(float* values, int* x, int* y, int* z, int count, ExpressionScratch& scratch,
+                EvaluateOffset&& evaluateOffset) const {
+                // Each moved coordinate is split into the element before it and the fraction of the way to the next.
+                // Splitting the displacement rather than the position keeps fractions exact far from the origin.
+                int* coordinates[3] = {x, y, z};
+                float* fractions[3] = {nullptr, nullptr, nullptr};
+                const std::shared_ptr<const ExpressionNode>* offsets[3] = {&mOffsetX, &mOffsetY, &mOffsetZ};
+                int numFractions = 0;
+                for (int axis = 0; axis < 3; ++axis) {
+                    if (*offsets[axis]) {
+                        fractions[axis] = scratch.acquire(count);
+                        ++numFractions;
+                        evaluateOffset(*offsets[axis], fractions[axis]);
+                        for (int i = 0; i < count; ++i) {
+                            const float displacement = mAmplitude * fractions[axis][i];
+                            const float step = std::floor(displacement);
+                            coordinates[axis][i] += static_cast<int>(step);
+                            fractions[axis][i] = displacement - step;
+                        }
+                    }
+                }
+                interpolate(values, coordinates, fractions, 0, count, scratch);
+                for (int i = 0; i < numFractions; ++i) {
+                    scratch.release();
+                }
+            }
+
+            // Interpolate the source along axis and every later axis that has fractions. Coordinates are moved to
+            // the next element and back, so they are unchanged afterwards.
+            void interpolate(float* values, int* const* coordinates, float* const* fractions, int axis, int count,
+                ExpressionScratch& scratch) const {
+                while (axis < 3 && !fractions[axis]) {
+                    ++axis;
+                }
+                if (axis == 3) {
+                    mSource->evaluatePoints(values, coordinates[0], coordinates[1], coordinates[2], count, scratch);
+                    return;
+                }
+                interpolate(values, coordinates, fractions, axis + 1, count, scratch);
+                float* next = scratch.acquire(count);
+                for (int i = 0; i < count; ++i) {
+                    ++coordinates[axis][i];
+                }
+                interpolate(next, coordinates, fractions, axis + 1, count, scratch);
+                for (int i = 0; i < count; ++i) {
+                    --coordinates[axis][i];
+                    values[i] += fractions[axis][i] * (next[i] - values[i]);
+                }
+                scratch.release();
+            }
+
+            const std::shared_ptr<const ExpressionNode> mSource, mOffsetX, mOffsetY, mOffsetZ;
+            const float mAmplitude;
+        };
+    } /* detail */
+
+    // A handle to an immutable expression. Handles are cheap to copy, and subexpressions can be shared.
+    class NoiseExpression {
+    public:
+        // Every element is value. Explicit, so that calls like max(1.0f, 2.0f) never build expressions. The
+        // arithmetic operators and min and max still take numbers next to an expression.
+        explicit NoiseExpression(float value) : mNode{std::make_shared<detail::ConstantNode>(value)} { }
+
+        explicit NoiseExpression(std::shared_ptr<const ExpressionNode> node) : mNode{std::move(node)} { }
+
+        // The field engine generates with distribution and seed. Matches generateChunk and generateRegion
+        // exactly. The engine must outlive the expression.
+        template <typename Distribution = DefaultDistribution>
+        static NoiseExpression field(const NoiseEngine& engine, Distribution distribution
+            = DefaultDistribution{0.f, 1.f}, long seed = 0) {
+            return NoiseExpression{std::make_shared<detail::FieldNode<Distribution>>(engine, std::move(distribution),
+                seed)};
+        }
+
+        // A map that has already been generated, for example by the generate or generateOctaves templates. The
+        // map must outlive the expression. Elements outside the map repeat its nearest edge.
+        template <typename GeneratedNoiseType>
+        static NoiseExpression map(const GeneratedNoiseType& generatedNoiseMap, int width, int length = 1,
+            int height = 1) {
+            return NoiseExpression{std::make_shared<detail::MapNode>(generatedNoiseMap.data(), width, length,
+                height)};
+        }
+
+        // Write the width x length x height box whose first element sits at (originX, originY, originZ) to
+        // generatedNoiseMap, one block of rows at a time.
+        template <typename GeneratedNoiseType>
+        GeneratedNoiseType& evaluate(GeneratedNoiseType& generatedNoiseMap, int width, int length = 1,
+            int height = 1, int originX = 0, int originY = 0, int originZ = 0, int numThreads = 1) const {
+            float* output = generatedNoiseMap.data();
+            const int rowsPerBlock = std::max(1, FusedBlockSize / width);
+            const int numRows = length * height;
+            const int numBlocks = ceilDivide(numRows, rowsPerBlock);
+            std::vector<ExpressionScratch> scratch(numWorkerThreads(numBlocks, numThreads));
+            parallelForEachThread(numBlocks, numThreads, [&](int thread, int beginBlock, int endBlock) {
+                for (int block = beginBlock; block < endBlock; ++block) {
+                    forEachRowBlock(block * rowsPerBlock, std::min((block + 1) * rowsPerBlock, numRows), length,
+                        [&](int beginY, int endY, int beginZ, int endZ) {
+                            // Every piece is contiguous in the map, so it is evaluated in place.
+                            mNode->evaluateBox(output + beginY * width + beginZ * width * length, originX,
+                                originY + beginY, originZ + beginZ, width, endY - beginY, endZ - beginZ,
+                                scratch[thread]);
+                        });
+                }
+            });
+            return generatedNoiseMap;
+        }
+
+        const std::shared_ptr<const ExpressionNode>& node() const noexcept {
+            return mNode;
+        }
+    private:
+        std::shared_ptr<const ExpressionNode> mNode;
+    };
+
+    namespace detail {
+        inline NoiseExpression binaryExpression(BinaryOperation operation, const NoiseExpression& left,
+            const NoiseExpression& right) {
+            return NoiseExpression{std::make_shared<BinaryNode>(operation, left.node(), right.node())};
+        }
+
+        template <typename Function>
+        NoiseExpression unaryExpression(const NoiseExpression& operand, Function func) {
+            return NoiseExpression{std::make_shared<UnaryNode<Function>>(operand.node(), std::move(func))};
+        }
+
+        // Operands of the binary functions below. Numbers stand for constant expressions.
+        inline const NoiseExpression& expressionOperand(const NoiseExpression& expression) noexcept {
+            return expression;
+        }
+
+        inline NoiseExpression expressionOperand(float value) {
+            return NoiseExpression{value};
+        }
+
+        template <typename Operand>
+        constexpr bool IsExpression = std::is_same_v<Operand, NoiseExpression>;
+
+        // Both operands are expressions or numbers, and at least one is an expression, so the binary functions
+        // never take part in overload resolution for plain numbers.
+        template <typename Left, typename Right>
+        using EnableIfExpressionOperands = std::enable_if_t<(IsExpression<Left> || IsExpression<Right>)
+            && (IsExpression<Left> || std::is_arithmetic_v<Left>)
+            && (IsExpression<Right> || std::is_arithmetic_v<Right>)>;
+    } /* detail */
+
+    template <typename Left, typename Right, typename = detail::EnableIfExpressionOperands<Left, Right>>
+    NoiseExpression operator+(const Left& left, const Right& right) {
+        return detail::binaryExpression(detail::BinaryOperation::Add, detail::expressionOperand(left),
+            detail::expressionOperand(right));
+    }
+
+    template <typename Left, typename Right, typename = detail::EnableIfExpressionOperands<Left, Right>>
+    NoiseExpression operator-(const Left& left, const Right& right) {
+        return detail::binaryExpression(detail::BinaryOperation::Subtract, detail::expressionOperand(left),
+            detail::expressionOperand(right));
+    }
+
+    template <typename Left, typename Right, typename = detail::EnableIfExpressionOperands<Left, Right>>
+    NoiseExpression operator*(const Left& left, const Right& right) {
+        return detail::binaryExpression(detail::BinaryOperation::Multiply, detail::expressionOperand(left),
+            detail::expressionOperand(right));
+    }
+
+    template <typename Left, typename Right, typename = detail::EnableIfExpressionOperands<Left, Right>>
+    NoiseExpression operator/(const Left& left, const Right& right) {
+        return detail::binaryExpression(detail::BinaryOperation::Divide, detail::expressionOperand(left),
+            detail::expressionOperand(right));
+    }
+
+    template <typename Left, typename Right, typename = detail::EnableIfExpressionOperands<Left, Right>>
+    NoiseExpression min(const Left& left, const Right& right) {
+        return detail::binaryExpression(detail::BinaryOperation::Minimum, detail::expressionOperand(left),
+            detail::expressionOperand(right));
+    }
+
+    template <typename Left, typename Right, typename = detail::EnableIfExpressionOperands<Left, Right>>
+    NoiseExpression max(const Left& left, const Right& right) {
+        return detail::binaryExpression(detail::BinaryOperation::Maximum, detail::expressionOperand(left),
+            detail::expressionOperand(right));
+    }
+
+    inline NoiseExpression clamp(const NoiseExpression& operand, float low, float high) {
+        return detail::unaryExpression(operand, [low, high](float value) {
+            return std::min(std::max(value, low), high);
+        });
+    }
+
+    inline NoiseExpression abs(const NoiseExpression& operand) {
+        return detail::unaryExpression(operand, [](float value) { return std::abs(value); });
+    }
+
+    // Folds the field around center: 1 - 2 * |value - center|. The center contour of the field becomes a line of
+    // sharp ridges of height 1.
+    inline NoiseExpression ridge(const NoiseExpression& operand, float center = 0.5f) {
+        return detail::unaryExpression(operand, [center](float value) {
+            return 1.0f - 2.0f * std::abs(value - center);
+        });
+    }
+
+    // Domain warp: element (x, y, z) is source evaluated at (x + amplitude * offsetX(x, y, z), ...), interpolated
+    // linearly between the elements around that position. Each warped axis doubles the number of source elements
+    // evaluated. Offsets are usually fields centered on 0. Leave offsetZ out for 2D maps.
+    inline NoiseExpression warp(const NoiseExpression& source, const NoiseExpression& offsetX,
+        const NoiseExpression& offsetY, float amplitude) {
+        return NoiseExpression{std::make_shared<detail::WarpNode>(source.node(), offsetX.node(), offsetY.node(),
+            nullptr, amplitude)};
+    }
+
+    inline NoiseExpression warp(const NoiseExpression& source, const NoiseExpression& offsetX,
+        const NoiseExpression& offsetY, const NoiseExpression& offsetZ, float amplitude) {
+        return NoiseExpression{std::make_shared<detail::WarpNode>(source.node(), offsetX.node(), offsetY.node(),
+            offsetZ.node(), amplitude)};
+    }
+} /* Stealth::Noise */
+
+#endif /* end of include guard: NOISE_EXPRESSION_H */
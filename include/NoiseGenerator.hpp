@@ -3,4 +3,9 @@
 #include "NoiseGenerator1D.hpp"
 #include "NoiseGenerator2D.hpp"
 #include "NoiseGenerator3D.hpp"
+#include "NoiseEngine.hpp"
+#include "NoiseExpression.hpp"
+#include "NoiseStream.hpp"
+#include "NoiseVolume.hpp"
+#include "NoiseWindow.hpp"
 #endif
@@ -1,14 +1,15 @@
 #ifndef NOISE_GENERATOR_1D_H
 #define NOISE_GENERATOR_1D_H
 #include "Internal.hpp"
+#include "Kernels.hpp"
 #include <Tensor3>
 #include <random>
 
 namespace Stealth::Noise {
     namespace {
-        constexpr float interpolate1D(float left, float right, float attenuation) noexcept {
+        inline float interpolate1D(float left, float right, float attenuation) noexcept {
             // Interpolate between two points
-            float nx = left * (1.0f - attenuation) + right * attenuation;
+            float nx = rounded(left * (1.0f - attenuation)) + rounded(right * attenuation);
             return nx;
         }
 
@@ -21,37 +22,36 @@ namespace Stealth::Noise {
             // Cache noise values
             float left = internalNoiseMap(internalX);
             float right = internalNoiseMap(internalX + 1);
-            // Loop over one interpolation kernel tile.
-            for (int i = 0; i < maxValidX; ++i) {
-                float attenuationX = attenuationsX(i);
-                // Interpolate based on the 2 surrounding internal noise points.
-                if constexpr (overwrite::value) {
-                    generatedNoiseMap(fillStartX + i) = interpolate1D(left, right, attenuationX);
-                } else {
-                    generatedNoiseMap(fillStartX + i) += interpolate1D(left, right, attenuationX) * multiplier;
-                }
-            }
+            // Interpolate the whole tile based on the 2 surrounding internal noise points.
+            interpolateRow<overwrite, scaleX>(generatedNoiseMap.data() + fillStartX, attenuationsX.data(), maxValidX,
+                left, right, multiplier);
         }
     } /* Anonymous namespace */
 
+    // Tiles of the map are split across numThreads threads; the output does not depend on numThreads. octave is only
+    // reported to the instrumentation sink.
     template <int width, int scaleX, typename overwrite = std::true_type,
         typename Distribution, typename GeneratedNoiseType>
     constexpr GeneratedNoiseType& generate(GeneratedNoiseType& generatedNoiseMap, Distribution&& distribution
         = DefaultDistribution{0.f, 1.f}, long seed = 0,
-        float multiplier = 1.0f) {
+        float multiplier = 1.0f, int numThreads = 1, int octave = 0) {
         // Get attenuation information
-        const auto attenuationsX{generateAttenuations<scaleX>()};
+        const auto attenuationsX{instrumentPhase(Phase::Attenuation, octave, scaleX, 1, 1, 0, 0,
+            generateAttenuations<scaleX>)};
         // Generate a new internal noise map.
         constexpr int internalWidth = ceilDivide(width, scaleX) + 1;
-        const auto internalNoiseMap{generateInternalNoiseMap<internalWidth>(seed,
-            std::forward<Distribution&&>(distribution))};
+        const auto internalNoiseMap{instrumentPhase(Phase::Lattice, octave, scaleX, 1, 1, 0, internalWidth, [&] {
+            return generateInternalNoiseMap<internalWidth>(seed, std::forward<Distribution&&>(distribution), numThreads);
+        })};
         // 1D noise map
-        int fillStartX = 0;
-        for (int i = 0; i < internalWidth - 1; ++i) {
-            // 1D noise unit
-            fillLine<width, overwrite>(i, fillStartX, internalNoiseMap, generatedNoiseMap, attenuationsX, multiplier);
-            fillStartX += scaleX;
-        }
+        parallelFor(internalWidth - 1, numThreads, [&](int beginTile, int endTile) {
+            PhaseTimer timer{Phase::Interpolation, octave, scaleX, 1, 1,
+                (long) std::min(endTile * scaleX, width) - beginTile * scaleX};
+            for (int i = beginTile; i < endTile; ++i) {
+                // 1D noise unit
+                fillLine<width, overwrite>(i, i * scaleX, internalNoiseMap, generatedNoiseMap, attenuationsX, multiplier);
+            }
+        });
         // Return noise map.
         return generatedNoiseMap;
     }
@@ -59,14 +59,15 @@ namespace Stealth::Noise {
     // Return a normalization factor and generate the noisemap in-place.
     template <int width, int scaleX, int numOctaves = 6, typename overwrite, typename Distribution, typename GeneratedNoiseType>
     constexpr float generateOctaves1D_impl(GeneratedNoiseType& generatedNoiseMap, long seed,
-        Distribution&& distribution, float decayFactor, float accumulator = 1.0f) {
+        Distribution&& distribution, float decayFactor, float accumulator = 1.0f, int numThreads = 1, int octave = 0) {
         // First generate this layer...
         generate<width, scaleX, overwrite>(generatedNoiseMap, std::forward<Distribution&&>(distribution),
-            seed, accumulator);
+            seed, accumulator, numThreads, octave);
         // ...then generate the next octaves.
         if constexpr (numOctaves > 1) {
             return accumulator + generateOctaves1D_impl<width, ceilDivide(scaleX, 2), numOctaves - 1, std::false_type>
-                (generatedNoiseMap, seed, std::forward<Distribution&&>(distribution), decayFactor, accumulator * decayFactor);
+                (generatedNoiseMap, octaveSeed(seed, 1), std::forward<Distribution&&>(distribution), decayFactor,
+                accumulator * decayFactor, numThreads, octave + 1);
         } else {
             return accumulator;
         }
@@ -76,10 +77,10 @@ namespace Stealth::Noise {
     template <int width, int scaleX, int numOctaves = 6, typename overwrite = std::true_type,
         typename Distribution, typename GeneratedNoiseType>
     constexpr GeneratedNoiseType& generateOctaves(GeneratedNoiseType& generatedNoiseMap, Distribution&& distribution
-        = DefaultDistribution{0.f, 1.f}, long seed = 0, float decayFactor = 0.5f) {
+        = DefaultDistribution{0.f, 1.f}, long seed = 0, float decayFactor = 0.5f, int numThreads = 1) {
         // Generate and normalize!
-        generatedNoiseMap /= generateOctaves1D_impl<width, scaleX, numOctaves, overwrite>(generatedNoiseMap, seed,
-            std::forward<Distribution&&>(distribution), decayFactor);
+        normalize(generatedNoiseMap, generateOctaves1D_impl<width, scaleX, numOctaves, overwrite>(generatedNoiseMap,
+            seed, std::forward<Distribution&&>(distribution), decayFactor, 1.0f, numThreads), numThreads);
         return generatedNoiseMap;
     }
 } /* Stealth::Noise */
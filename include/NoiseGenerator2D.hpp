@@ -7,28 +7,27 @@
 
 namespace Stealth::Noise {
     namespace {
-        constexpr float interpolate2D(float topLeft, float topRight, float bottomLeft,
+        // Interpolates vertically first so that the per-row work can be hoisted out of fillSquare.
+        inline float interpolate2D(float topLeft, float topRight, float bottomLeft,
             float bottomRight, float attenuationX, float attenuationY) noexcept {
-            // Interpolate horizontally
-            float nx0 = interpolate1D(topLeft, topRight, attenuationX);
-            float nx1 = interpolate1D(bottomLeft, bottomRight, attenuationX);
             // Interpolate vertically
-            float nxy = interpolate1D(nx0, nx1, attenuationY);
+            float ny0 = interpolate1D(topLeft, bottomLeft, attenuationY);
+            float ny1 = interpolate1D(topRight, bottomRight, attenuationY);
+            // Interpolate horizontally
+            float nxy = interpolate1D(ny0, ny1, attenuationX);
             return nxy;
         }
 
-        // Interpolate a square section among 4 corners.
-        template <int width, int length, typename overwrite, int scaleX, int scaleY,
+        // Interpolate the part [beginX, endX) x [beginY, endY) of a square section among 4 corners. Ranges are
+        // relative to the tile, whose first element lands at (fillStartX, fillStartY) in the noise map. Rows are
+        // width elements apart, which differs from the map's own width when a flat 3D map is generated as 2D.
+        template <int width, int internalWidth, typename overwrite, int scaleX, int scaleY,
             typename InternalNoiseType, typename GeneratedNoiseType>
-        constexpr void fillSquare(int internalX, int internalY, int fillStartX, int fillStartY,
-            const InternalNoiseType& internalNoiseMap, GeneratedNoiseType& generatedNoiseMap,
+        constexpr void fillSquare(int internalX, int internalY, int fillStartX, int fillStartY, int beginX, int endX,
+            int beginY, int endY, const InternalNoiseType& internalNoiseMap, GeneratedNoiseType& generatedNoiseMap,
             const Stealth::Tensor::Tensor3F<scaleX>& attenuationsX, const Stealth::Tensor::Tensor3F<scaleY>& attenuationsY,
             float multiplier = 1.0f) {
-            // Only fill the part of the tile that is valid.
-            const int maxValidX = std::min(width - fillStartX, scaleX);
-            const int maxValidY = std::min(length - fillStartY, scaleY);
             // Cache noise indices
-            constexpr int internalWidth = ceilDivide(width, scaleX) + 1;
             const int topLeftIndex = internalX + internalY * internalWidth;
             const int bottomLeftIndex = topLeftIndex + internalWidth;
             // Cache noise values
@@ -37,59 +36,74 @@ namespace Stealth::Noise {
             float bottomLeft = internalNoiseMap(bottomLeftIndex);
             float bottomRight = internalNoiseMap(bottomLeftIndex + 1);
             // Loop over one interpolation kernel tile.
-            int index = fillStartX + fillStartY * generatedNoiseMap.width();
-            for (int j = 0; j < maxValidY; ++j) {
+            float* row = generatedNoiseMap.data() + (fillStartX + beginX) + (fillStartY + beginY) * width;
+            for (int j = beginY; j < endY; ++j) {
+                // Interpolate the edges of this row once, then sweep the whole row.
                 float attenuationY = attenuationsY(j);
-                for (int i = 0; i < maxValidX; ++i) {
-                    float attenuationX = attenuationsX(i);
-                    // Interpolate based on the 4 surrounding internal noise points.
-                    if constexpr (overwrite::value) {
-                        generatedNoiseMap(index++) = interpolate2D(topLeft, topRight, bottomLeft,
-                            bottomRight, attenuationX, attenuationY);
-                    } else {
-                        generatedNoiseMap(index++) += interpolate2D(topLeft, topRight, bottomLeft,
-                            bottomRight, attenuationX, attenuationY) * multiplier;
-                    }
+                float left = interpolate1D(topLeft, bottomLeft, attenuationY);
+                float right = interpolate1D(topRight, bottomRight, attenuationY);
+                interpolateRow<overwrite, scaleX>(row, attenuationsX.data() + beginX, endX - beginX, left, right, multiplier);
+                // Move to the first element of the next row.
+                row += width;
+            }
+        }
+
+        // Fill the rows [beginY, endY) of the noise map one tile at a time. Element (x, y) of the map lies at
+        // (x + offsetX, y + offsetY) relative to the first point of the internal noise map.
+        template <int width, int internalWidth, typename overwrite, int scaleX, int scaleY,
+            typename InternalNoiseType, typename GeneratedNoiseType>
+        constexpr void fillRows2D(int offsetX, int offsetY, int beginY, int endY, const InternalNoiseType& internalNoiseMap,
+            GeneratedNoiseType& generatedNoiseMap, const Stealth::Tensor::Tensor3F<scaleX>& attenuationsX,
+            const Stealth::Tensor::Tensor3F<scaleY>& attenuationsY, float multiplier = 1.0f) {
+            for (int j = (beginY + offsetY) / scaleY; j * scaleY - offsetY < endY; ++j) {
+                // Only fill the rows of this tile that fall inside the requested range.
+                const int fillStartY = j * scaleY - offsetY;
+                const int tileBeginY = std::max(beginY - fillStartY, 0);
+                const int tileEndY = std::min(endY - fillStartY, scaleY);
+                for (int i = 0; i * scaleX - offsetX < width; ++i) {
+                    // 2D noise unit
+                    const int fillStartX = i * scaleX - offsetX;
+                    fillSquare<width, internalWidth, overwrite>(i, j, fillStartX, fillStartY, std::max(-fillStartX, 0),
+                        std::min(width - fillStartX, scaleX), tileBeginY, tileEndY, internalNoiseMap, generatedNoiseMap,
+                        attenuationsX, attenuationsY, multiplier);
                 }
-                // Wrap around to the first element of the next row.
-                index += generatedNoiseMap.width() - maxValidX;
             }
         }
     } /* Anonymous namespace */
 
+    // Rows of the map are split across numThreads threads; the output does not depend on numThreads. octave is only
+    // reported to the instrumentation sink.
     template <int width, int length, int scaleX, int scaleY, typename overwrite
         = std::true_type, typename Distribution, typename GeneratedNoiseType>
     constexpr GeneratedNoiseType& generate(GeneratedNoiseType& generatedNoiseMap, Distribution&& distribution
         = DefaultDistribution{0.f, 1.f}, long seed = 0,
-        float multiplier = 1.0f) {
+        float multiplier = 1.0f, int numThreads = 1, int octave = 0) {
         // Generate 1D noise if there's only 1 dimension.
         if constexpr (length == 1) {
             return generate<width, scaleX, overwrite>(generatedNoiseMap,
-                std::forward<Distribution&&>(distribution), seed, multiplier);
+                std::forward<Distribution&&>(distribution), seed, multiplier, numThreads, octave);
         } else if constexpr (width == 1) {
             return generate<length, scaleY, overwrite>(generatedNoiseMap,
-                std::forward<Distribution&&>(distribution), seed, multiplier);
+                std::forward<Distribution&&>(distribution), seed, multiplier, numThreads, octave);
         }
         // Get attenuation information
+        PhaseTimer attenuationTimer{Phase::Attenuation, octave, scaleX, scaleY, 1};
         const auto attenuationsX{generateAttenuations<scaleX>()};
         const auto attenuationsY{generateAttenuations<scaleY>()};
+        attenuationTimer.stop();
         // Generate a new internal noise map.
         constexpr int internalWidth = ceilDivide(width, scaleX) + 1;
         constexpr int internalLength = ceilDivide(length, scaleY) + 1;
+        PhaseTimer latticeTimer{Phase::Lattice, octave, scaleX, scaleY, 1, 0, internalWidth * internalLength};
         const auto internalNoiseMap{generateInternalNoiseMap<internalWidth, internalLength>
-            (seed, std::forward<Distribution&&>(distribution))};
+            (seed, std::forward<Distribution&&>(distribution), numThreads)};
+        latticeTimer.stop();
         // 2D noise map
-        int fillStartX = 0, fillStartY = 0;
-        for (int j = 0; j < internalLength - 1; ++j) {
-            fillStartX = 0;
-            for (int i = 0; i < internalWidth - 1; ++i) {
-                // 2D noise unit
-                fillSquare<width, length, overwrite>(i, j, fillStartX, fillStartY,
-                    internalNoiseMap, generatedNoiseMap, attenuationsX, attenuationsY, multiplier);
-                fillStartX += scaleX;
-            }
-            fillStartY += scaleY;
-        }
+        parallelFor(length, numThreads, [&](int beginY, int endY) {
+            PhaseTimer timer{Phase::Interpolation, octave, scaleX, scaleY, 1, (long) (endY - beginY) * width};
+            fillRows2D<width, internalWidth, overwrite>(0, 0, beginY, endY, internalNoiseMap, generatedNoiseMap,
+                attenuationsX, attenuationsY, multiplier);
+        });
         // Return noise map.
         return generatedNoiseMap;
     }
@@ -97,30 +111,116 @@ namespace Stealth::Noise {
     // Return a normalization factor and generate the noisemap in-place.
     template <int width, int length, int scaleX, int scaleY, int numOctaves = 6, typename overwrite, typename Distribution, typename GeneratedNoiseType>
     constexpr float generateOctaves2D_impl(GeneratedNoiseType& generatedNoiseMap, long seed,
-        Distribution&& distribution, float decayFactor, float accumulator = 1.0f) {
+        Distribution&& distribution, float decayFactor, float accumulator = 1.0f, int numThreads = 1, int octave = 0) {
         // First generate this layer...
         generate<width, length, scaleX, scaleY, overwrite>(generatedNoiseMap,
-            std::forward<Distribution&&>(distribution), seed, accumulator);
+            std::forward<Distribution&&>(distribution), seed, accumulator, numThreads, octave);
         // ...then generate the next octaves.
         if constexpr (numOctaves > 1) {
             return accumulator + generateOctaves2D_impl<width, length, ceilDivide(scaleX, 2),
-                ceilDivide(scaleY, 2), numOctaves - 1, std::false_type>(generatedNoiseMap, seed, std::forward<Distribution&&>(distribution),
-                decayFactor, accumulator * decayFactor);
+                ceilDivide(scaleY, 2), numOctaves - 1, std::false_type>(generatedNoiseMap, octaveSeed(seed, 1),
+                std::forward<Distribution&&>(distribution), decayFactor, accumulator * decayFactor, numThreads,
+                octave + 1);
         } else {
             return accumulator;
         }
     }
 
+    // Attenuations and internal noise maps for every octave of a 2D map whose first element sits at
+    // (originX, originY) in the infinite noise field. These are generated up front so that all octaves
+    // can be accumulated while a block of the output is in cache. Lattices of flat maps are relabeled like
+    // generate relabels them, so the map at the origin is the one generateOctaves produces.
+    template <int width, int length, int scaleX, int scaleY, int numOctaves>
+    struct OctaveStack2D {
+        template <typename Distribution>
+        OctaveStack2D(int64_t originX, int64_t originY, long seed, Distribution&& distribution, float decayFactor,
+            int numThreads = 1, float accumulator = 1.0f, int octave = 0) : octave{octave},
+            offsetX{latticeOffset(originX, scaleX)}, offsetY{latticeOffset(originY, scaleY)},
+            internalNoiseMap{instrumentPhase(Phase::Lattice, octave, scaleX, scaleY, 1, 0,
+                internalWidth * internalLength, [&] {
+                    return generateInternalNoiseMap<internalWidth, internalLength, 1,
+                        MapLattice<width, length, 1>>(seed, std::forward<Distribution&&>(distribution), numThreads,
+                        latticeCoordinate(originX, scaleX), latticeCoordinate(originY, scaleY));
+                })}, multiplier{accumulator},
+            next{originX, originY, octaveSeed(seed, 1), std::forward<Distribution&&>(distribution), decayFactor,
+                numThreads, accumulator * decayFactor, octave + 1},
+            normalizationFactor{accumulator + next.normalizationFactor} { }
+
+        // Fill the rows [beginY, endY) with the sum of every octave.
+        template <typename overwrite, typename GeneratedNoiseType>
+        void fill(int beginY, int endY, GeneratedNoiseType& generatedNoiseMap) const {
+            PhaseTimer timer{Phase::Interpolation, octave, scaleX, scaleY, 1, (long) (endY - beginY) * width};
+            fillRows2D<width, internalWidth, overwrite>(offsetX, offsetY, beginY, endY, internalNoiseMap,
+                generatedNoiseMap, attenuationsX, attenuationsY, multiplier);
+            timer.stop();
+            next.template fill<std::false_type>(beginY, endY, generatedNoiseMap);
+        }
+
+        // An unaligned origin can straddle one more lattice cell than an aligned one.
+        static constexpr int internalWidth = ceilDivide(width, scaleX) + 2;
+        static constexpr int internalLength = ceilDivide(length, scaleY) + 2;
+        // Position in the stack, only reported to the instrumentation sink.
+        const int octave;
+        const int offsetX, offsetY;
+        const Stealth::Tensor::Tensor3F<scaleX> attenuationsX{instrumentPhase(Phase::Attenuation, octave, scaleX,
+            scaleY, 1, 0, 0, generateAttenuations<scaleX>)};
+        const Stealth::Tensor::Tensor3F<scaleY> attenuationsY{instrumentPhase(Phase::Attenuation, octave, scaleX,
+            scaleY, 1, 0, 0, generateAttenuations<scaleY>)};
+        const Stealth::Tensor::Tensor3F<internalWidth * internalLength> internalNoiseMap;
+        const float multiplier;
+        const OctaveStack2D<width, length, ceilDivide(scaleX, 2), ceilDivide(scaleY, 2), numOctaves - 1> next;
+        const float normalizationFactor;
+    };
+
+    template <int width, int length, int scaleX, int scaleY>
+    struct OctaveStack2D<width, length, scaleX, scaleY, 0> {
+        template <typename Distribution>
+        OctaveStack2D(int64_t, int64_t, long, Distribution&&, float, int, float, int) { }
+
+        template <typename overwrite, typename GeneratedNoiseType>
+        void fill(int, int, GeneratedNoiseType&) const { }
+
+        const float normalizationFactor = 0.0f;
+    };
+
     // Convenience overloads
     template <int width, int length, int scaleX, int scaleY, int numOctaves = 6, typename overwrite
         = std::true_type, typename Distribution, typename GeneratedNoiseType>
     constexpr GeneratedNoiseType& generateOctaves(GeneratedNoiseType& generatedNoiseMap, Distribution&& distribution
-        = DefaultDistribution{0.f, 1.f}, long seed = 0, float decayFactor = 0.5f) {
+        = DefaultDistribution{0.f, 1.f}, long seed = 0, float decayFactor = 0.5f, int numThreads = 1) {
         // Generate and normalize!
-        generatedNoiseMap /= generateOctaves2D_impl<width, length, scaleX, scaleY, numOctaves, overwrite>(generatedNoiseMap,
-            seed, std::forward<Distribution&&>(distribution), decayFactor);
+        normalize(generatedNoiseMap, generateOctaves2D_impl<width, length, scaleX, scaleY, numOctaves, overwrite>
+            (generatedNoiseMap, seed, std::forward<Distribution&&>(distribution), decayFactor, 1.0f, numThreads), numThreads);
+        return generatedNoiseMap;
+    }
+
+    // Generate the chunk at (chunkX, chunkY) of an infinite noise field tiled by width x length chunks.
+    // Neighbouring chunks line up exactly, and the cost only depends on the chunk size, so chunks can be
+    // generated lazily, in any order and on any thread. Chunk (0, 0) is the map generateOctaves produces.
+    template <int width, int length, int scaleX, int scaleY, int numOctaves = 6, typename overwrite
+        = std::true_type, typename Distribution, typename GeneratedNoiseType>
+    GeneratedNoiseType& generateChunk(GeneratedNoiseType& generatedNoiseMap, int chunkX, int chunkY,
+        Distribution&& distribution = DefaultDistribution{0.f, 1.f}, long seed = 0, float decayFactor = 0.5f,
+        int numThreads = 1) {
+        const OctaveStack2D<width, length, scaleX, scaleY, numOctaves> octaves{static_cast<int64_t>(chunkX) * width,
+            static_cast<int64_t>(chunkY) * length, seed, std::forward<Distribution&&>(distribution), decayFactor,
+            numThreads};
+        forEachFusedBlock<width, length, 1>(numThreads, [&](int beginY, int endY, int, int) {
+            octaves.template fill<overwrite>(beginY, endY, generatedNoiseMap);
+            normalizeBlock(generatedNoiseMap, octaves.normalizationFactor, beginY, endY, 0, 1);
+        });
         return generatedNoiseMap;
     }
+
+    // Same result as generateOctaves, but makes a single pass over memory: every octave and the normalization
+    // are applied to one cache-sized block of rows before moving on to the next.
+    template <int width, int length, int scaleX, int scaleY, int numOctaves = 6, typename overwrite
+        = std::true_type, typename Distribution, typename GeneratedNoiseType>
+    GeneratedNoiseType& generateOctavesFused(GeneratedNoiseType& generatedNoiseMap, Distribution&& distribution
+        = DefaultDistribution{0.f, 1.f}, long seed = 0, float decayFactor = 0.5f, int numThreads = 1) {
+        return generateChunk<width, length, scaleX, scaleY, numOctaves, overwrite>(generatedNoiseMap, 0, 0,
+            std::forward<Distribution&&>(distribution), seed, decayFactor, numThreads);
+    }
 } /* Stealth::Noise */
 
 #endif /* end of include guard: NOISE_GENERATOR_2D_H */
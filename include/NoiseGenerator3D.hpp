@@ -7,31 +7,30 @@
 
 namespace Stealth::Noise {
     namespace {
-        constexpr float interpolate3D(float topLeft0, float topRight0, float bottomLeft0, float bottomRight0,
+        // Interpolates between layers first so that the per-layer work can be hoisted out of fillCube.
+        inline float interpolate3D(float topLeft0, float topRight0, float bottomLeft0, float bottomRight0,
             float topLeft1, float topRight1, float bottomLeft1, float bottomRight1,
             float attenuationX, float attenuationY, float attenuationZ) noexcept {
-            // Interpolate bottom layer
-            float nz0 = interpolate2D(topLeft0, topRight0, bottomLeft0, bottomRight0, attenuationX, attenuationY);
-            float nz1 = interpolate2D(topLeft1, topRight1, bottomLeft1, bottomRight1, attenuationX, attenuationY);
             // Interpolate between two layers
-            float nxyz = interpolate1D(nz0, nz1, attenuationZ);
+            float topLeft = interpolate1D(topLeft0, topLeft1, attenuationZ);
+            float topRight = interpolate1D(topRight0, topRight1, attenuationZ);
+            float bottomLeft = interpolate1D(bottomLeft0, bottomLeft1, attenuationZ);
+            float bottomRight = interpolate1D(bottomRight0, bottomRight1, attenuationZ);
+            // Interpolate the resulting square
+            float nxyz = interpolate2D(topLeft, topRight, bottomLeft, bottomRight, attenuationX, attenuationY);
             return nxyz;
         }
 
-        // Interpolate a cubic section among 8 corners.
-        template <int width, int length, int height, typename overwrite, int scaleX,
-            int scaleY, int scaleZ, typename InternalNoiseType, typename GeneratedNoiseType>
+        // Interpolate the part [beginX, endX) x [beginY, endY) x [beginZ, endZ) of a cubic section among 8 corners.
+        // Ranges are relative to the tile, whose first element lands at (fillStartX, fillStartY, fillStartZ) in the map.
+        template <int internalWidth, int internalLength, typename overwrite, int scaleX, int scaleY, int scaleZ,
+            typename InternalNoiseType, typename GeneratedNoiseType>
         constexpr void fillCube(int internalX, int internalY, int internalZ, int fillStartX, int fillStartY, int fillStartZ,
-            const InternalNoiseType& internalNoiseMap, GeneratedNoiseType& generatedNoiseMap,
-            const Stealth::Tensor::Tensor3F<scaleX>& attenuationsX, const Stealth::Tensor::Tensor3F<scaleY>& attenuationsY,
-            const Stealth::Tensor::Tensor3F<scaleZ>& attenuationsZ, float multiplier = 1.0f) {
-            // Only fill the part of the tile that is valid.
-            const int maxValidX = std::min(width - fillStartX, scaleX);
-            const int maxValidY = std::min(length - fillStartY, scaleY);
-            const int maxValidZ = std::min(height - fillStartZ, scaleZ);
+            int beginX, int endX, int beginY, int endY, int beginZ, int endZ, const InternalNoiseType& internalNoiseMap,
+            GeneratedNoiseType& generatedNoiseMap, const Stealth::Tensor::Tensor3F<scaleX>& attenuationsX,
+            const Stealth::Tensor::Tensor3F<scaleY>& attenuationsY, const Stealth::Tensor::Tensor3F<scaleZ>& attenuationsZ,
+            float multiplier = 1.0f) {
             // Cache noise indices
-            constexpr int internalWidth = ceilDivide(width, scaleX) + 1;
-            constexpr int internalLength = ceilDivide(length, scaleY) + 1;
             constexpr int internalArea = internalWidth * internalLength;
             const int topLeft0Index = internalX + internalY * internalWidth + internalZ * internalArea;
             const int bottomLeft0Index = topLeft0Index + internalWidth;
@@ -47,72 +46,100 @@ namespace Stealth::Noise {
             float bottomLeft1 = internalNoiseMap(bottomLeft1Index);
             float bottomRight1 = internalNoiseMap(bottomLeft1Index + 1);
             // Loop over one interpolation kernel tile.
-            int index = fillStartX + fillStartY * generatedNoiseMap.width() + fillStartZ * generatedNoiseMap.area();
-            for (int k = 0; k < maxValidZ; ++k) {
+            float* layer = generatedNoiseMap.data() + (fillStartX + beginX) + (fillStartY + beginY) * generatedNoiseMap.width()
+                + (fillStartZ + beginZ) * generatedNoiseMap.area();
+            for (int k = beginZ; k < endZ; ++k) {
+                // Interpolate the corners of this layer once...
                 float attenuationZ = attenuationsZ(k);
-                for (int j = 0; j < maxValidY; ++j) {
+                float topLeft = interpolate1D(topLeft0, topLeft1, attenuationZ);
+                float topRight = interpolate1D(topRight0, topRight1, attenuationZ);
+                float bottomLeft = interpolate1D(bottomLeft0, bottomLeft1, attenuationZ);
+                float bottomRight = interpolate1D(bottomRight0, bottomRight1, attenuationZ);
+                float* row = layer;
+                for (int j = beginY; j < endY; ++j) {
+                    // ...then the edges of each row, then sweep the whole row.
                     float attenuationY = attenuationsY(j);
-                    for (int i = 0; i < maxValidX; ++i) {
-                        float attenuationX = attenuationsX(i);
-                        // Interpolate based on the 8 surrounding internal noise points.
-                        if constexpr (overwrite::value) {
-                            generatedNoiseMap(index++) = interpolate3D(topLeft0, topRight0, bottomLeft0, bottomRight0,
-                                topLeft1, topRight1, bottomLeft1, bottomRight1, attenuationX, attenuationY, attenuationZ);
-                        } else {
-                            generatedNoiseMap(index++) += interpolate3D(topLeft0, topRight0, bottomLeft0, bottomRight0,
-                                topLeft1, topRight1, bottomLeft1, bottomRight1, attenuationX, attenuationY, attenuationZ) * multiplier;
-                        }
+                    float left = interpolate1D(topLeft, bottomLeft, attenuationY);
+                    float right = interpolate1D(topRight, bottomRight, attenuationY);
+                    interpolateRow<overwrite, scaleX>(row, attenuationsX.data() + beginX, endX - beginX, left, right, multiplier);
+                    // Move to the first element of the next row.
+                    row += generatedNoiseMap.width();
+                }
+                // Move to the first element of the next layer.
+                layer += generatedNoiseMap.area();
+            }
+        }
+
+        // Fill the rows [beginY, endY) of layers [beginZ, endZ) of the noise map one tile at a time. Element (x, y, z)
+        // of the map lies at (x + offsetX, y + offsetY, z + offsetZ) relative to the first point of the internal noise map.
+        template <int width, int internalWidth, int internalLength, typename overwrite, int scaleX, int scaleY, int scaleZ,
+            typename InternalNoiseType, typename GeneratedNoiseType>
+        constexpr void fillBlock3D(int offsetX, int offsetY, int offsetZ, int beginY, int endY, int beginZ, int endZ,
+            const InternalNoiseType& internalNoiseMap, GeneratedNoiseType& generatedNoiseMap,
+            const Stealth::Tensor::Tensor3F<scaleX>& attenuationsX, const Stealth::Tensor::Tensor3F<scaleY>& attenuationsY,
+            const Stealth::Tensor::Tensor3F<scaleZ>& attenuationsZ, float multiplier = 1.0f) {
+            for (int k = (beginZ + offsetZ) / scaleZ; k * scaleZ - offsetZ < endZ; ++k) {
+                // Only fill the layers of this tile that fall inside the requested block.
+                const int fillStartZ = k * scaleZ - offsetZ;
+                const int tileBeginZ = std::max(beginZ - fillStartZ, 0);
+                const int tileEndZ = std::min(endZ - fillStartZ, scaleZ);
+                for (int j = (beginY + offsetY) / scaleY; j * scaleY - offsetY < endY; ++j) {
+                    const int fillStartY = j * scaleY - offsetY;
+                    const int tileBeginY = std::max(beginY - fillStartY, 0);
+                    const int tileEndY = std::min(endY - fillStartY, scaleY);
+                    for (int i = 0; i * scaleX - offsetX < width; ++i) {
+                        // 3D noise unit
+                        const int fillStartX = i * scaleX - offsetX;
+                        fillCube<internalWidth, internalLength, overwrite>(i, j, k, fillStartX, fillStartY, fillStartZ,
+                            std::max(-fillStartX, 0), std::min(width - fillStartX, scaleX), tileBeginY, tileEndY,
+                            tileBeginZ, tileEndZ, internalNoiseMap, generatedNoiseMap, attenuationsX, attenuationsY,
+                            attenuationsZ, multiplier);
                     }
-                    // Wrap around to the first element of the next row.
-                    index += generatedNoiseMap.width() - maxValidX;
                 }
-                // Wrap around to the first element of the next tile
-                index += generatedNoiseMap.area() - maxValidY * generatedNoiseMap.width();
             }
         }
     } /* Anonymous namespace */
 
+    // Rows of the map are split across numThreads threads; the output does not depend on numThreads. octave is only
+    // reported to the instrumentation sink.
     template <int width, int length, int height, int scaleX, int scaleY, int scaleZ, typename overwrite
         = std::true_type, typename Distribution, typename GeneratedNoiseType>
     constexpr GeneratedNoiseType& generate(GeneratedNoiseType& generatedNoiseMap, Distribution&& distribution
-        = DefaultDistribution{0.f, 1.f}, long seed = 0, float multiplier = 1.0f) {
+        = DefaultDistribution{0.f, 1.f}, long seed = 0, float multiplier = 1.0f, int numThreads = 1, int octave = 0) {
         // Generate 2D noise if there are only 2 dimensions.
         if constexpr (height == 1) {
             return generate<width, length, scaleX, scaleY, overwrite>(generatedNoiseMap,
-                std::forward<Distribution&&>(distribution), seed, multiplier);
+                std::forward<Distribution&&>(distribution), seed, multiplier, numThreads, octave);
         } else if constexpr (length == 1) {
             return generate<width, height, scaleX, scaleZ, overwrite>(generatedNoiseMap,
-                std::forward<Distribution&&>(distribution), seed, multiplier);
+                std::forward<Distribution&&>(distribution), seed, multiplier, numThreads, octave);
         } else if constexpr (width == 1) {
             return generate<length, height, scaleY, scaleZ, overwrite>(generatedNoiseMap,
-                std::forward<Distribution&&>(distribution), seed, multiplier);
+                std::forward<Distribution&&>(distribution), seed, multiplier, numThreads, octave);
         }
         // Get attenuation information
+        PhaseTimer attenuationTimer{Phase::Attenuation, octave, scaleX, scaleY, scaleZ};
         const auto attenuationsX{generateAttenuations<scaleX>()};
         const auto attenuationsY{generateAttenuations<scaleY>()};
         const auto attenuationsZ{generateAttenuations<scaleZ>()};
+        attenuationTimer.stop();
         // Generate a new internal noise map.
         constexpr int internalWidth = ceilDivide(width, scaleX) + 1;
         constexpr int internalLength = ceilDivide(length, scaleY) + 1;
         constexpr int internalHeight = ceilDivide(height, scaleZ) + 1;
+        PhaseTimer latticeTimer{Phase::Lattice, octave, scaleX, scaleY, scaleZ, 0,
+            internalWidth * internalLength * internalHeight};
         const auto internalNoiseMap{generateInternalNoiseMap<internalWidth, internalLength, internalHeight>
-            (seed, std::forward<Distribution&&>(distribution))};
-        // 3D noise map
-        int fillStartX = 0, fillStartY = 0, fillStartZ = 0;
-        for (int k = 0; k < internalHeight - 1; ++k) {
-            fillStartY = 0;
-            for (int j = 0; j < internalLength - 1; ++j) {
-                fillStartX = 0;
-                for (int i = 0; i < internalWidth - 1; ++i) {
-                    // 3D noise unit
-                    fillCube<width, length, height, overwrite>(i, j, k, fillStartX, fillStartY, fillStartZ, internalNoiseMap, generatedNoiseMap,
-                        attenuationsX, attenuationsY, attenuationsZ, multiplier);
-                    fillStartX += scaleX;
-                }
-                fillStartY += scaleY;
-            }
-            fillStartZ += scaleZ;
-        }
+            (seed, std::forward<Distribution&&>(distribution), numThreads)};
+        latticeTimer.stop();
+        // 3D noise map. Split on rows rather than layers so that shallow maps still spread across all threads.
+        parallelFor(length * height, numThreads, [&](int beginRow, int endRow) {
+            PhaseTimer timer{Phase::Interpolation, octave, scaleX, scaleY, scaleZ, (long) (endRow - beginRow) * width};
+            forEachRowBlock(beginRow, endRow, length, [&](int beginY, int endY, int beginZ, int endZ) {
+                fillBlock3D<width, internalWidth, internalLength, overwrite>(0, 0, 0, beginY, endY, beginZ, endZ,
+                    internalNoiseMap, generatedNoiseMap, attenuationsX, attenuationsY, attenuationsZ, multiplier);
+            });
+        });
         // Return noise map.
         return generatedNoiseMap;
     }
@@ -121,30 +148,132 @@ namespace Stealth::Noise {
     template <int width, int length, int height, int scaleX, int scaleY, int scaleZ, int numOctaves = 6,
         typename overwrite, typename Distribution, typename GeneratedNoiseType>
     constexpr float generateOctaves3D_impl(GeneratedNoiseType& generatedNoiseMap, long seed,
-        Distribution&& distribution, float decayFactor, float accumulator = 1.0f) {
+        Distribution&& distribution, float decayFactor, float accumulator = 1.0f, int numThreads = 1, int octave = 0) {
         // First generate this layer...
         generate<width, length, height, scaleX, scaleY, scaleZ, overwrite>(generatedNoiseMap,
-            std::forward<Distribution&&>(distribution), seed, accumulator);
+            std::forward<Distribution&&>(distribution), seed, accumulator, numThreads, octave);
         // ...then generate the next octaves.
         if constexpr (numOctaves > 1) {
             return accumulator + generateOctaves3D_impl<width, length, height, ceilDivide(scaleX, 2),
                 ceilDivide(scaleY, 2), ceilDivide(scaleZ, 2), numOctaves - 1, std::false_type>
-                (generatedNoiseMap, seed, std::forward<Distribution&&>(distribution), decayFactor, accumulator * decayFactor);
+                (generatedNoiseMap, octaveSeed(seed, 1), std::forward<Distribution&&>(distribution), decayFactor,
+                accumulator * decayFactor, numThreads, octave + 1);
         } else {
             return accumulator;
         }
     }
 
+    // Attenuations and internal noise maps for every octave of a 3D map whose first element sits at
+    // (originX, originY, originZ) in the infinite noise field. These are generated up front so that all
+    // octaves can be accumulated while a block of the output is in cache. Lattices of flat maps are relabeled
+    // like generate relabels them, so the map at the origin is the one generateOctaves produces.
+    template <int width, int length, int height, int scaleX, int scaleY, int scaleZ, int numOctaves>
+    struct OctaveStack3D {
+        template <typename Distribution>
+        OctaveStack3D(int64_t originX, int64_t originY, int64_t originZ, long seed, Distribution&& distribution,
+            float decayFactor, int numThreads = 1, float accumulator = 1.0f, int octave = 0) : octave{octave},
+            offsetX{latticeOffset(originX, scaleX)}, offsetY{latticeOffset(originY, scaleY)},
+            offsetZ{latticeOffset(originZ, scaleZ)},
+            internalNoiseMap{instrumentPhase(Phase::Lattice, octave, scaleX, scaleY, scaleZ, 0,
+                internalWidth * internalLength * internalHeight, [&] {
+                    return generateInternalNoiseMap<internalWidth, internalLength, internalHeight,
+                        MapLattice<width, length, height>>(seed, std::forward<Distribution&&>(distribution),
+                        numThreads, latticeCoordinate(originX, scaleX), latticeCoordinate(originY, scaleY),
+                        latticeCoordinate(originZ, scaleZ));
+                })}, multiplier{accumulator},
+            next{originX, originY, originZ, octaveSeed(seed, 1), std::forward<Distribution&&>(distribution),
+                decayFactor, numThreads, accumulator * decayFactor, octave + 1},
+            normalizationFactor{accumulator + next.normalizationFactor} { }
+
+        // Fill the rows [beginY, endY) of layers [beginZ, endZ) with the sum of every octave.
+        template <typename overwrite, typename GeneratedNoiseType>
+        void fill(int beginY, int endY, int beginZ, int endZ, GeneratedNoiseType& generatedNoiseMap) const {
+            PhaseTimer timer{Phase::Interpolation, octave, scaleX, scaleY, scaleZ,
+                (long) (endY - beginY) * (endZ - beginZ) * width};
+            fillBlock3D<width, internalWidth, internalLength, overwrite>(offsetX, offsetY, offsetZ, beginY, endY,
+                beginZ, endZ, internalNoiseMap, generatedNoiseMap, attenuationsX, attenuationsY, attenuationsZ,
+                multiplier);
+            timer.stop();
+            next.template fill<std::false_type>(beginY, endY, beginZ, endZ, generatedNoiseMap);
+        }
+
+        // An unaligned origin can straddle one more lattice cell than an aligned one.
+        static constexpr int internalWidth = ceilDivide(width, scaleX) + 2;
+        static constexpr int internalLength = ceilDivide(length, scaleY) + 2;
+        static constexpr int internalHeight = ceilDivide(height, scaleZ) + 2;
+        // Position in the stack, only reported to the instrumentation sink.
+        const int octave;
+        const int offsetX, offsetY, offsetZ;
+        const Stealth::Tensor::Tensor3F<scaleX> attenuationsX{instrumentPhase(Phase::Attenuation, octave, scaleX,
+            scaleY, scaleZ, 0, 0, generateAttenuations<scaleX>)};
+        const Stealth::Tensor::Tensor3F<scaleY> attenuationsY{instrumentPhase(Phase::Attenuation, octave, scaleX,
+            scaleY, scaleZ, 0, 0, generateAttenuations<scaleY>)};
+        const Stealth::Tensor::Tensor3F<scaleZ> attenuationsZ{instrumentPhase(Phase::Attenuation, octave, scaleX,
+            scaleY, scaleZ, 0, 0, generateAttenuations<scaleZ>)};
+        const Stealth::Tensor::Tensor3F<internalWidth * internalLength * internalHeight> internalNoiseMap;
+        const float multiplier;
+        const OctaveStack3D<width, length, height, ceilDivide(scaleX, 2), ceilDivide(scaleY, 2),
+            ceilDivide(scaleZ, 2), numOctaves - 1> next;
+        const float normalizationFactor;
+    };
+
+    template <int width, int length, int height, int scaleX, int scaleY, int scaleZ>
+    struct OctaveStack3D<width, length, height, scaleX, scaleY, scaleZ, 0> {
+        template <typename Distribution>
+        OctaveStack3D(int64_t, int64_t, int64_t, long, Distribution&&, float, int, float, int) { }
+
+        template <typename overwrite, typename GeneratedNoiseType>
+        void fill(int, int, int, int, GeneratedNoiseType&) const { }
+
+        const float normalizationFactor = 0.0f;
+    };
+
     // Convenience overloads
     template <int width, int length, int height, int scaleX, int scaleY, int scaleZ, int numOctaves = 6,
         typename overwrite = std::true_type, typename Distribution, typename GeneratedNoiseType>
     constexpr GeneratedNoiseType& generateOctaves(GeneratedNoiseType& generatedNoiseMap, Distribution&& distribution
-        = DefaultDistribution{0.f, 1.f}, long seed = 0, float decayFactor = 0.5f) {
+        = DefaultDistribution{0.f, 1.f}, long seed = 0, float decayFactor = 0.5f, int numThreads = 1) {
         // Generate and normalize!
-        generatedNoiseMap /= generateOctaves3D_impl<width, length, height, scaleX, scaleY, scaleZ, numOctaves, overwrite>
-            (generatedNoiseMap, seed, std::forward<Distribution&&>(distribution), decayFactor);
+        normalize(generatedNoiseMap, generateOctaves3D_impl<width, length, height, scaleX, scaleY, scaleZ, numOctaves,
+            overwrite>(generatedNoiseMap, seed, std::forward<Distribution&&>(distribution), decayFactor, 1.0f, numThreads),
+            numThreads);
+        return generatedNoiseMap;
+    }
+
+    // Generate the chunk at (chunkX, chunkY, chunkZ) of an infinite noise field tiled by width x length x height
+    // chunks. Neighbouring chunks line up exactly, and the cost only depends on the chunk size, so chunks can be
+    // generated lazily, in any order and on any thread. Chunk (0, 0, 0) is the map generateOctaves produces.
+    template <int width, int length, int height, int scaleX, int scaleY, int scaleZ, int numOctaves = 6,
+        typename overwrite = std::true_type, typename Distribution, typename GeneratedNoiseType>
+    GeneratedNoiseType& generateChunk(GeneratedNoiseType& generatedNoiseMap, int chunkX, int chunkY, int chunkZ,
+        Distribution&& distribution = DefaultDistribution{0.f, 1.f}, long seed = 0, float decayFactor = 0.5f,
+        int numThreads = 1) {
+        const OctaveStack3D<width, length, height, scaleX, scaleY, scaleZ, numOctaves> octaves{
+            static_cast<int64_t>(chunkX) * width, static_cast<int64_t>(chunkY) * length,
+            static_cast<int64_t>(chunkZ) * height, seed, std::forward<Distribution&&>(distribution), decayFactor,
+            numThreads};
+        forEachFusedBlock<width, length, height>(numThreads, [&](int beginY, int endY, int beginZ, int endZ) {
+            octaves.template fill<overwrite>(beginY, endY, beginZ, endZ, generatedNoiseMap);
+            normalizeBlock(generatedNoiseMap, octaves.normalizationFactor, beginY, endY, beginZ, endZ);
+        });
         return generatedNoiseMap;
     }
+
+    // Same result as generateOctaves, but makes a single pass over memory: every octave and the normalization
+    // are applied to one cache-sized block of rows before moving on to the next.
+    template <int width, int length, int height, int scaleX, int scaleY, int scaleZ, int numOctaves = 6,
+        typename overwrite = std::true_type, typename Distribution, typename GeneratedNoiseType>
+    GeneratedNoiseType& generateOctavesFused(GeneratedNoiseType& generatedNoiseMap, Distribution&& distribution
+        = DefaultDistribution{0.f, 1.f}, long seed = 0, float decayFactor = 0.5f, int numThreads = 1) {
+        // Generate 2D noise if there are only 2 dimensions.
+        if constexpr (height == 1) {
+            return generateOctavesFused<width, length, scaleX, scaleY, numOctaves, overwrite>(generatedNoiseMap,
+                std::forward<Distribution&&>(distribution), seed, decayFactor, numThreads);
+        } else {
+            return generateChunk<width, length, height, scaleX, scaleY, scaleZ, numOctaves, overwrite>(generatedNoiseMap,
+                0, 0, 0, std::forward<Distribution&&>(distribution), seed, decayFactor, numThreads);
+        }
+    }
 } /* Stealth::Noise */
 
 #endif /* end of include guard: NOISE_GENERATOR_3D_H */
@@ -0,0 +1,137 @@
+#ifndef NOISE_STREAM_H
+#define NOISE_STREAM_H
+#include "NoiseEngine.hpp"
+#include "Internal.hpp"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Stealth::Noise {
+    // Generates the map NoiseEngine::generateOctaves produces one slab of layers at a time, in order, on a background
+    // thread. Finished slabs wait in a bounded queue, so a consumer can work on the first slab while later slabs are
+    // still being generated. Peak memory is queueCapacity + 2 slabs plus the lattice layers around the current slab,
+    // instead of the whole volume. Slabs match the corresponding layers of the dense map exactly.
+    template <typename Distribution = DefaultDistribution>
+    class NoiseStream {
+    public:
+        // Layers [beginZ, endZ) of the map, stored like a map of (endZ - beginZ) layers.
+        struct Slab {
+            int beginZ, endZ;
+            const float* values;
+        };
+
+        // Generation starts right away. The engine must outlive the stream. numThreads threads work on each slab, on
+        // top of the producer thread itself.
+        NoiseStream(const NoiseEngine& engine, Distribution distribution = DefaultDistribution{0.f, 1.f}, long seed = 0,
+            int slabDepth = 1, int queueCapacity = 2, int numThreads = 1) : mEngine{engine},
+            mDistribution{std::move(distribution)}, mSeed{seed}, mSlabDepth{std::max(1, slabDepth)},
+            mQueueCapacity{std::max(1, queueCapacity)}, mNumThreads{numThreads} {
+            // One slab for every queue slot, one being generated and one held by the consumer.
+            mBuffers.resize(mQueueCapacity + 2);
+            for (auto& buffer : mBuffers) {
+                buffer.resize(static_cast<size_t>(mSlabDepth) * engine.width() * engine.length());
+                mFree.emplace_back(buffer.data());
+            }
+            mProducer = std::thread{[this] {
+                produce();
+            }};
+        }
+
+        NoiseStream(const NoiseStream&) = delete;
+        NoiseStream& operator=(const NoiseStream&) = delete;
+
+        ~NoiseStream() {
+            {
+                std::lock_guard<std::mutex> lock{mMutex};
+                mStopped = true;
+            }
+            mChanged.notify_all();
+            mProducer.join();
+        }
+
+        // Wait for the next slab. The previous slab returned by next() is released and must no longer be used.
+        // Returns false once every slab has been consumed.
+        bool next(Slab& slab) {
+            std::unique_lock<std::mutex> lock{mMutex};
+            if (mHeld) {
+                mFree.emplace_back(mHeld);
+                mHeld = nullptr;
+                mChanged.notify_all();
+            }
+            mChanged.wait(lock, [this] {
+                return !mReady.empty() || mFinished;
+            });
+            if (mReady.empty()) {
+                return false;
+            }
+            const ReadySlab& ready = mReady.front();
+            slab = Slab{ready.beginZ, ready.endZ, ready.values};
+            mHeld = ready.values;
+            mReady.pop_front();
+            mChanged.notify_all();
+            return true;
+        }
+
+        int slabDepth() const noexcept {
+            return mSlabDepth;
+        }
+
+        int numSlabs() const noexcept {
+            return ceilDivide(mEngine.height(), mSlabDepth);
+        }
+    private:
+        struct ReadySlab {
+            int beginZ, endZ;
+            float* values;
+        };
+
+        void produce() {
+            NoiseLayerCache cache{};
+            for (int beginZ = 0; beginZ < mEngine.height(); beginZ += mSlabDepth) {
+                float* buffer = nullptr;
+                {
+                    std::unique_lock<std::mutex> lock{mMutex};
+                    // A full queue leaves no free buffer, which keeps the producer at most queueCapacity slabs ahead.
+                    mChanged.wait(lock, [this] {
+                        return !mFree.empty() || mStopped;
+                    });
+                    if (mStopped) {
+                        return;
+                    }
+                    buffer = mFree.back();
+                    mFree.pop_back();
+                }
+                const int endZ = std::min(beginZ + mSlabDepth, mEngine.height());
+                mEngine.generateLayers(buffer, cache, beginZ, endZ, mDistribution, mSeed, mNumThreads);
+                {
+                    std::lock_guard<std::mutex> lock{mMutex};
+                    mReady.emplace_back(ReadySlab{beginZ, endZ, buffer});
+                }
+                mChanged.notify_all();
+            }
+            {
+                std::lock_guard<std::mutex> lock{mMutex};
+                mFinished = true;
+            }
+            mChanged.notify_all();
+        }
+
+        const NoiseEngine& mEngine;
+        const Distribution mDistribution;
+        const long mSeed;
+        const int mSlabDepth, mQueueCapacity, mNumThreads;
+        std::vector<std::vector<float>> mBuffers;
+        // Guarded by mMutex.
+        std::deque<ReadySlab> mReady;
+        std::vector<float*> mFree;
+        float* mHeld = nullptr;
+        bool mStopped = false, mFinished = false;
+        std::mutex mMutex;
+        std::condition_variable mChanged;
+        std::thread mProducer;
+    };
+} /* Stealth::Noise */
+
+#endif /* end of include guard: NOISE_STREAM_H */
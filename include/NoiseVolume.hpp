@@ -0,0 +1,373 @@
+#ifndef NOISE_VOLUME_H
+#define NOISE_VOLUME_H
+#include "NoiseEngine.hpp"
+#include "Internal.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Noise volumes stored in files and mapped into memory, so that maps larger than RAM can be generated and maps
+// generated by an earlier run can be used again without copying them. A volume is a grid of an engine's chunks, so
+// its size is only limited by the disk, not by the largest map one engine can generate.
+namespace Stealth::Noise {
+    // Bump whenever the lattice, the interpolation or the file layout changes, so that old files are regenerated.
+    constexpr uint32_t NoiseVolumeVersion = 1;
+
+    // The first bytes of every volume file. Describes everything the values depend on, so a file can be checked
+    // against a request before it is used. There is no padding, so headers can be compared with memcmp.
+    struct NoiseVolumeHeader {
+        char magic[8];
+        uint32_t version;
+        // Byte offset of the first value. Page aligned, so the values can be mapped directly.
+        uint32_t dataOffset;
+        // The shape of the volume, a whole number of chunks along every axis.
+        int32_t width, length, height;
+        int32_t scaleX, scaleY, scaleZ;
+        int32_t numOctaves;
+        float decayFactor;
+        int64_t seed;
+        // Hash of the full distribution description, which may not fit in distribution.
+        uint64_t distributionHash;
+        // NoiseVolumeByteOrder as written by the machine that generated the file. Values are stored in native byte
+        // order, so files from machines of the other byte order read as a swapped marker and are rejected.
+        uint32_t byteOrder;
+        // The shape of the engine's chunks.
+        int32_t chunkWidth, chunkLength, chunkHeight;
+        // The distribution's type and parameters, for people reading the file.
+        char distribution[176];
+    };
+    static_assert(sizeof(NoiseVolumeHeader) == 256, "NoiseVolumeHeader must not contain padding");
+
+    namespace {
+        constexpr char NoiseVolumeMagic[8] = "STNOISE";
+        constexpr uint32_t NoiseVolumeByteOrder = 0x01020304;
+        constexpr uint32_t NoiseVolumePageSize = 4096;
+        // Layers are generated and written back in slabs of about this many floats.
+        constexpr size_t NoiseVolumeSlabSize = size_t{1} << 24;
+
+        // 64-bit FNV-1a.
+        inline uint64_t hashBytes(const void* bytes, size_t size, uint64_t hash = 0xCBF29CE484222325ull) noexcept {
+            const unsigned char* data = static_cast<const unsigned char*>(bytes);
+            for (size_t i = 0; i < size; ++i) {
+                hash = (hash ^ data[i]) * 0x100000001B3ull;
+            }
+            return hash;
+        }
+
+        // The distributions with fast paths are described by their parameters. Others must support operator<<,
+        // like every standard distribution does.
+        template <typename Distribution>
+        std::string describeDistribution(const Distribution& distribution) {
+            std::ostringstream description;
+            description << std::hexfloat;
+            if constexpr (std::is_same_v<Distribution, std::uniform_real_distribution<float>>) {
+                description << "uniform " << distribution.a() << " " << distribution.b();
+            } else if constexpr (std::is_same_v<Distribution, std::normal_distribution<float>>) {
+                description << "normal " << distribution.mean() << " " << distribution.stddev();
+            } else {
+                description << typeid(Distribution).name() << " " << distribution;
+            }
+            return description.str();
+        }
+    }
+
+    // The header of the volume engine generates from distribution and seed: chunksX x chunksY x chunksZ of its chunks,
+    // starting with chunk (0, 0, 0). Throws std::invalid_argument if the grid is empty or a side of the volume has
+    // 2^31 or more elements.
+    template <typename Distribution = DefaultDistribution>
+    NoiseVolumeHeader noiseVolumeHeader(const NoiseEngine& engine, const Distribution& distribution
+        = DefaultDistribution{0.f, 1.f}, long seed = 0, int chunksX = 1, int chunksY = 1, int chunksZ = 1) {
+        constexpr int64_t maxSide = std::numeric_limits<int32_t>::max();
+        if (chunksX < 1 || chunksY < 1 || chunksZ < 1) {
+            throw std::invalid_argument{"Noise volumes need at least one chunk along every axis"};
+        }
+        if (int64_t{chunksX} * engine.width() > maxSide || int64_t{chunksY} * engine.length() > maxSide
+            || int64_t{chunksZ} * engine.height() > maxSide) {
+            throw std::invalid_argument{"Noise volumes must have fewer than 2^31 elements along every axis"};
+        }
+        NoiseVolumeHeader header{};
+        std::memcpy(header.magic, NoiseVolumeMagic, sizeof(header.magic));
+        header.version = NoiseVolumeVersion;
+        header.byteOrder = NoiseVolumeByteOrder;
+        header.dataOffset = NoiseVolumePageSize;
+        header.width = chunksX * engine.width();
+        header.length = chunksY * engine.length();
+        header.height = chunksZ * engine.height();
+        header.chunkWidth = engine.width();
+        header.chunkLength = engine.length();
+        header.chunkHeight = engine.height();
+        header.scaleX = engine.octaves().front().scaleX;
+        header.scaleY = engine.octaves().front().scaleY;
+        header.scaleZ = engine.octaves().front().scaleZ;
+        header.numOctaves = engine.numOctaves();
+        header.decayFactor = engine.decayFactor();
+        header.seed = seed;
+        const std::string description = describeDistribution(distribution);
+        header.distributionHash = hashBytes(description.data(), description.size());
+        description.copy(header.distribution, sizeof(header.distribution) - 1);
+        return header;
+    }
+
+    // A volume file mapped into memory, laid out like a map generateOctaves produces. It only has data() and
+    // size(), so it can be passed to the NoiseEngine, but not to the templated generators, which need a Tensor3.
+    // Invalid (false) if the file could not be created or opened.
+    class NoiseVolume {
+    public:
+        NoiseVolume() = default;
+
+        NoiseVolume(NoiseVolume&& other) noexcept {
+            *this = std::move(other);
+        }
+
+        NoiseVolume& operator=(NoiseVolume&& other) noexcept {
+            if (this != &other) {
+                unmap();
+                std::swap(mMapping, other.mMapping);
+                std::swap(mMappingSize, other.mMappingSize);
+            }
+            return *this;
+        }
+
+        NoiseVolume(const NoiseVolume&) = delete;
+        NoiseVolume& operator=(const NoiseVolume&) = delete;
+
+        ~NoiseVolume() {
+            unmap();
+        }
+
+        // Create or replace the file at path with a volume described by header, with every value 0. Writes to the
+        // volume go to the file.
+        static NoiseVolume create(const std::string& path, const NoiseVolumeHeader& header) {
+            NoiseVolume volume{};
+            const int file = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (file < 0) {
+                return volume;
+            }
+            const size_t size = header.dataOffset + valueCount(header) * sizeof(float);
+            if (::ftruncate(file, static_cast<off_t>(size)) == 0) {
+                volume.map(file, size, PROT_READ | PROT_WRITE, MAP_SHARED);
+            }
+            ::close(file);
+            if (volume) {
+                std::memcpy(volume.mMapping, &header, sizeof(header));
+            }
+            return volume;
+        }
+
+        // Map the volume file at path. Pages are only read from the file when they are first touched. Writes to
+        // the volume stay in memory and never reach the file. Invalid if the file is not a complete volume of
+        // this version and byte order.
+        static NoiseVolume open(const std::string& path) {
+            NoiseVolume volume{};
+            const int file = ::open(path.c_str(), O_RDONLY);
+            if (file < 0) {
+                return volume;
+            }
+            NoiseVolumeHeader header{};
+            struct stat status{};
+            if (::pread(file, &header, sizeof(header), 0) == sizeof(header) && ::fstat(file, &status) == 0
+                && std::memcmp(header.magic, NoiseVolumeMagic, sizeof(header.magic)) == 0
+                && header.version == NoiseVolumeVersion && header.byteOrder == NoiseVolumeByteOrder
+                && header.dataOffset % NoiseVolumePageSize == 0
+                && header.dataOffset >= sizeof(header) && header.width > 0 && header.length > 0 && header.height > 0
+                && holdsValues(header, static_cast<size_t>(status.st_size))) {
+                // Only pages that are written are copied, so no swap is reserved for the rest. Otherwise volumes
+                // larger than memory could not be opened at all.
+                volume.map(file, status.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_NORESERVE);
+            }
+            ::close(file);
+            return volume;
+        }
+
+        explicit operator bool() const noexcept {
+            return mMapping != nullptr;
+        }
+
+        // Only valid volumes have a header.
+        const NoiseVolumeHeader& header() const noexcept {
+            assert(mMapping && "NoiseVolume::header() called on an invalid volume");
+            return *static_cast<const NoiseVolumeHeader*>(mMapping);
+        }
+
+        // Null for invalid volumes.
+        float* data() noexcept {
+            return mMapping ? reinterpret_cast<float*>(static_cast<char*>(mMapping) + header().dataOffset) : nullptr;
+        }
+
+        const float* data() const noexcept {
+            return mMapping ? reinterpret_cast<const float*>(static_cast<const char*>(mMapping) + header().dataOffset)
+                : nullptr;
+        }
+
+        // Number of values. 0 for invalid volumes.
+        size_t size() const noexcept {
+            return mMapping ? valueCount(header()) : 0;
+        }
+
+        // Write layers [beginZ, endZ) back to the file and drop them from memory. They are read back in if they
+        // are touched again. Keeps memory use bounded while a volume larger than RAM is being filled.
+        void release(int beginZ, int endZ) noexcept {
+            if (!mMapping) {
+                return;
+            }
+            const size_t layerSize = static_cast<size_t>(header().width) * header().length * sizeof(float);
+            // Whole pages only. Pages shared with neighbouring layers are simply written back early.
+            const size_t begin = (header().dataOffset + beginZ * layerSize) / NoiseVolumePageSize
+                * NoiseVolumePageSize;
+            const size_t end = std::min(header().dataOffset + endZ * layerSize, mMappingSize);
+            char* const mapping = static_cast<char*>(mMapping);
+            if (begin < end) {
+                ::msync(mapping + begin, end - begin, MS_SYNC);
+                ::madvise(mapping + begin, end - begin, MADV_DONTNEED);
+            }
+        }
+    private:
+        static size_t valueCount(const NoiseVolumeHeader& header) noexcept {
+            return static_cast<size_t>(header.width) * header.length * header.height;
+        }
+
+        // Whether a file of fileSize bytes holds exactly the values header describes. Divides instead of
+        // multiplying, so that the dimensions of a damaged header cannot overflow into a matching size.
+        static bool holdsValues(const NoiseVolumeHeader& header, size_t fileSize) noexcept {
+            if (fileSize < header.dataOffset || (fileSize - header.dataOffset) % sizeof(float) != 0) {
+                return false;
+            }
+            const size_t values = (fileSize - header.dataOffset) / sizeof(float);
+            const size_t layerSize = static_cast<size_t>(header.width) * header.length;
+            return values % layerSize == 0 && values / layerSize == static_cast<size_t>(header.height);
+        }
+
+        void map(int file, size_t size, int protection, int flags) noexcept {
+            void* mapping = ::mmap(nullptr, size, protection, flags, file, 0);
+            if (mapping != MAP_FAILED) {
+                mMapping = mapping;
+                mMappingSize = size;
+            }
+        }
+
+        void unmap() noexcept {
+            if (mMapping) {
+                ::munmap(mMapping, mMappingSize);
+                mMapping = nullptr;
+                mMappingSize = 0;
+            }
+        }
+
+        void* mMapping = nullptr;
+        size_t mMappingSize = 0;
+    };
+
+    // Generate chunksX x chunksY x chunksZ chunks of engine, starting with chunk (0, 0, 0), straight into a new volume
+    // file at path. Element (x, y, z) of the volume is the element generateChunk puts at (x mod width, y mod length,
+    // z mod height) of chunk (x / width, y / length, z / height); a single chunk is the map generateOctaves produces.
+    // The volume is generated a slab of layers at a time, one chunk-sized tile after another, and every slab is
+    // written back as soon as it is finished, so only a few slabs are ever resident, however large the volume is.
+    template <typename Distribution = DefaultDistribution>
+    NoiseVolume generateVolume(const std::string& path, const NoiseEngine& engine, const Distribution& distribution
+        = DefaultDistribution{0.f, 1.f}, long seed = 0, int numThreads = 1, int chunksX = 1, int chunksY = 1,
+        int chunksZ = 1) {
+        const NoiseVolumeHeader header = noiseVolumeHeader(engine, distribution, seed, chunksX, chunksY, chunksZ);
+        NoiseVolume volume = NoiseVolume::create(path, header);
+        if (!volume) {
+            return volume;
+        }
+        const size_t layerSize = static_cast<size_t>(header.width) * header.length;
+        // generateRegion takes int strides, so slabs of layers too large for one are generated a layer at a time.
+        const int slabDepth = (layerSize > static_cast<size_t>(std::numeric_limits<int>::max())) ? 1
+            : static_cast<int>(std::clamp<size_t>(NoiseVolumeSlabSize / layerSize, 1, engine.height()));
+        const int layerStride = (slabDepth == 1) ? 0 : static_cast<int>(layerSize);
+        NoiseWorkspace workspace{};
+        for (int beginZ = 0; beginZ < header.height; beginZ += slabDepth) {
+            const int endZ = std::min(beginZ + slabDepth, header.height);
+            for (int y = 0; y < header.length; y += engine.length()) {
+                for (int x = 0; x < header.width; x += engine.width()) {
+                    engine.generateRegion(volume.data() + beginZ * layerSize + static_cast<size_t>(y) * header.width
+                        + x, header.width, layerStride, workspace, x, y, beginZ, engine.width(), engine.length(),
+                        endZ - beginZ, distribution, seed, numThreads);
+                }
+            }
+            volume.release(beginZ, endZ);
+        }
+        return volume;
+    }
+
+    // Volumes kept in a directory, named after a hash of their header. The first request for a (shape, chunk grid,
+    // scales, octaves, decay, distribution, seed) combination generates the volume, later requests, including those
+    // of later runs, just map the file.
+    class NoiseVolumeCache {
+    public:
+        // The directory is created if it does not exist. Its parent must exist.
+        explicit NoiseVolumeCache(std::string directory) : mDirectory{std::move(directory)} {
+            ::mkdir(mDirectory.c_str(), 0755);
+        }
+
+        template <typename Distribution = DefaultDistribution>
+        std::string path(const NoiseEngine& engine, const Distribution& distribution = DefaultDistribution{0.f, 1.f},
+            long seed = 0, int chunksX = 1, int chunksY = 1, int chunksZ = 1) const {
+            return path(noiseVolumeHeader(engine, distribution, seed, chunksX, chunksY, chunksZ));
+        }
+
+        // Whether a matching volume has already been generated.
+        template <typename Distribution = DefaultDistribution>
+        bool contains(const NoiseEngine& engine, const Distribution& distribution = DefaultDistribution{0.f, 1.f},
+            long seed = 0, int chunksX = 1, int chunksY = 1, int chunksZ = 1) const {
+            const NoiseVolumeHeader header = noiseVolumeHeader(engine, distribution, seed, chunksX, chunksY, chunksZ);
+            return static_cast<bool>(find(path(header), header));
+        }
+
+        // Map the matching volume, generating it first if it is not in the cache yet. The result behaves like
+        // NoiseVolume::open. Invalid only if the cache directory cannot be written.
+        template <typename Distribution = DefaultDistribution>
+        NoiseVolume get(const NoiseEngine& engine, const Distribution& distribution = DefaultDistribution{0.f, 1.f},
+            long seed = 0, int numThreads = 1, int chunksX = 1, int chunksY = 1, int chunksZ = 1) const {
+            const NoiseVolumeHeader header = noiseVolumeHeader(engine, distribution, seed, chunksX, chunksY, chunksZ);
+            const std::string volumePath = path(header);
+            NoiseVolume volume = find(volumePath, header);
+            if (volume) {
+                return volume;
+            }
+            // Generate under a temporary name, so that no other process ever maps a partial volume.
+            const std::string temporaryPath = volumePath + ".tmp" + std::to_string(::getpid());
+            if (!generateVolume(temporaryPath, engine, distribution, seed, numThreads, chunksX, chunksY, chunksZ)
+                || std::rename(temporaryPath.c_str(), volumePath.c_str()) != 0) {
+                std::remove(temporaryPath.c_str());
+                return NoiseVolume{};
+            }
+            return find(volumePath, header);
+        }
+    private:
+        std::string path(const NoiseVolumeHeader& header) const {
+            std::ostringstream name;
+            name << mDirectory << "/" << std::hex << std::setw(16) << std::setfill('0')
+                << hashBytes(&header, sizeof(header)) << ".noise";
+            return name.str();
+        }
+
+        // The volume at path if it matches header exactly. Hash collisions and stale files do not match.
+        static NoiseVolume find(const std::string& path, const NoiseVolumeHeader& header) {
+            NoiseVolume volume = NoiseVolume::open(path);
+            if (volume && std::memcmp(&volume.header(), &header, sizeof(header)) != 0) {
+                return NoiseVolume{};
+            }
+            return volume;
+        }
+
+        std::string mDirectory;
+    };
+} /* Stealth::Noise */
+
+#endif /* end of include guard: NOISE_VOLUME_H */
@@ -0,0 +1,166 @@
+#ifndef NOISE_WINDOW_H
+#define NOISE_WINDOW_H
+#include "NoiseEngine.hpp"
+#include "Internal.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace Stealth::Noise {
+    // A width x length x height view of the infinite noise field that can be scrolled. Storage is a toroidal ring
+    // buffer: the element at (x, y, z) of the field lives at (x mod width, y mod length, z mod height), so values
+    // that stay in view never move. Moving the window only generates the rows, columns and layers that come into
+    // view, for every octave, so the cost of a move is proportional to the number of newly exposed elements.
+    // Coordinates match generateChunk: a window at (chunkX * width, chunkY * length, chunkZ * height) holds
+    // exactly that chunk. Origins are 64-bit like the engine's, so windows can scroll to any chunk. Newly exposed
+    // strips are often narrower than a vector, so they go through the scalar tail of the row kernel; since that tail
+    // rounds exactly like the vector lanes, a scrolled window is bit-identical to a fresh one on every target.
+    template <typename Distribution = DefaultDistribution>
+    class NoiseWindow {
+    public:
+        NoiseWindow(int width, int length, int height, int scaleX, int scaleY, int scaleZ, int numOctaves = 6,
+            float decayFactor = 0.5f, Distribution distribution = DefaultDistribution{0.f, 1.f}, long seed = 0,
+            int numThreads = 1, int64_t originX = 0, int64_t originY = 0, int64_t originZ = 0)
+            : mEngine{width, length, height, scaleX, scaleY, scaleZ, numOctaves, decayFactor},
+            mDistribution{std::move(distribution)}, mSeed{seed}, mNumThreads{numThreads},
+            mValues(mEngine.size()), mOriginX{originX}, mOriginY{originY}, mOriginZ{originZ} {
+            generateBox(originX, originY, originZ, width, length, height);
+        }
+
+        // Move the window so that its first element sits at (originX, originY, originZ) in the noise field.
+        void moveTo(int64_t originX, int64_t originY, int64_t originZ) {
+            const int64_t deltaX = originX - mOriginX, deltaY = originY - mOriginY, deltaZ = originZ - mOriginZ;
+            mOriginX = originX;
+            mOriginY = originY;
+            mOriginZ = originZ;
+            if (std::abs(deltaX) >= width() || std::abs(deltaY) >= length() || std::abs(deltaZ) >= height()) {
+                // Nothing stays in view.
+                generateBox(originX, originY, originZ, width(), length(), height());
+                return;
+            }
+            // Shifts smaller than the window fit in an int.
+            const int shiftX = static_cast<int>(deltaX), shiftY = static_cast<int>(deltaY), shiftZ = static_cast<int>(deltaZ);
+            // The part of each axis that was already in view.
+            const int keptBeginX = std::max(0, -shiftX), keptEndX = std::min(width(), width() - shiftX);
+            const int keptBeginY = std::max(0, -shiftY), keptEndY = std::min(length(), length() - shiftY);
+            // Newly exposed columns span the whole window...
+            const int exposedX = (shiftX > 0) ? keptEndX : 0;
+            generateBox(originX + exposedX, originY, originZ, std::abs(shiftX), length(), height());
+            // ...rows only span the columns that were kept...
+            const int exposedY = (shiftY > 0) ? keptEndY : 0;
+            generateBox(originX + keptBeginX, originY + exposedY, originZ, keptEndX - keptBeginX, std::abs(shiftY),
+                height());
+            // ...and layers only span the rows and columns that were kept.
+            const int exposedZ = (shiftZ > 0) ? height() - shiftZ : 0;
+            generateBox(originX + keptBeginX, originY + keptBeginY, originZ + exposedZ, keptEndX - keptBeginX,
+                keptEndY - keptBeginY, std::abs(shiftZ));
+        }
+
+        void move(int64_t shiftX, int64_t shiftY, int64_t shiftZ = 0) {
+            moveTo(mOriginX + shiftX, mOriginY + shiftY, mOriginZ + shiftZ);
+        }
+
+        // The element at (x, y, z) relative to the window's origin.
+        float operator()(int x, int y, int z = 0) const {
+            return mValues[ringIndex(mOriginX + x, width()) + ringIndex(mOriginY + y, length()) * width()
+                + ringIndex(mOriginZ + z, height()) * width() * length()];
+        }
+
+        // Unroll the ring buffer into a dense map with the window's shape, with the origin at element 0.
+        template <typename GeneratedNoiseType>
+        GeneratedNoiseType& copyTo(GeneratedNoiseType& generatedNoiseMap) const {
+            float* output = generatedNoiseMap.data();
+            const int firstX = ringIndex(mOriginX, width());
+            for (int z = 0; z < height(); ++z) {
+                for (int y = 0; y < length(); ++y) {
+                    const float* row = mValues.data() + ringIndex(mOriginY + y, length()) * width()
+                        + ringIndex(mOriginZ + z, height()) * width() * length();
+                    // Each row wraps around at most once.
+                    std::memcpy(output, row + firstX, (width() - firstX) * sizeof(float));
+                    std::memcpy(output + width() - firstX, row, firstX * sizeof(float));
+                    output += width();
+                }
+            }
+            return generatedNoiseMap;
+        }
+
+        // The ring buffer itself. The element at (x, y, z) of the field is at
+        // ringIndex(x, width()) + ringIndex(y, length()) * width() + ringIndex(z, height()) * width() * length().
+        const float* data() const noexcept {
+            return mValues.data();
+        }
+
+        static constexpr int ringIndex(int64_t coordinate, int size) noexcept {
+            return latticeOffset(coordinate, size);
+        }
+
+        int width() const noexcept {
+            return mEngine.width();
+        }
+
+        int length() const noexcept {
+            return mEngine.length();
+        }
+
+        int height() const noexcept {
+            return mEngine.height();
+        }
+
+        int64_t originX() const noexcept {
+            return mOriginX;
+        }
+
+        int64_t originY() const noexcept {
+            return mOriginY;
+        }
+
+        int64_t originZ() const noexcept {
+            return mOriginZ;
+        }
+
+        const NoiseEngine& engine() const noexcept {
+            return mEngine;
+        }
+    private:
+        // Generate a box of the field into the ring buffer. Boxes that wrap around the buffer are split into at most
+        // 8 pieces that do not.
+        void generateBox(int64_t beginX, int64_t beginY, int64_t beginZ, int sizeX, int sizeY, int sizeZ) {
+            if (sizeX <= 0 || sizeY <= 0 || sizeZ <= 0) {
+                return;
+            }
+            forEachRingPiece(beginX, sizeX, width(), [&](int64_t x, int pieceX, int ringX) {
+                forEachRingPiece(beginY, sizeY, length(), [&](int64_t y, int pieceY, int ringY) {
+                    forEachRingPiece(beginZ, sizeZ, height(), [&](int64_t z, int pieceZ, int ringZ) {
+                        mEngine.generateRegion(mValues.data() + ringX + ringY * width() + ringZ * width() * length(),
+                            width(), width() * length(), mWorkspace, x, y, z, pieceX, pieceY, pieceZ, mDistribution,
+                            mSeed, mNumThreads);
+                    });
+                });
+            });
+        }
+
+        // Split [begin, begin + size) into the pieces that do not wrap around a ring of the given length and call
+        // func(begin, size, ringBegin) on each.
+        template <typename Function>
+        static void forEachRingPiece(int64_t begin, int size, int ringSize, Function&& func) {
+            const int ringBegin = ringIndex(begin, ringSize);
+            const int firstSize = std::min(size, ringSize - ringBegin);
+            func(begin, firstSize, ringBegin);
+            if (firstSize < size) {
+                func(begin + firstSize, size - firstSize, 0);
+            }
+        }
+
+        const NoiseEngine mEngine;
+        NoiseWorkspace mWorkspace{};
+        const Distribution mDistribution;
+        const long mSeed;
+        const int mNumThreads;
+        std::vector<float> mValues;
+        int64_t mOriginX, mOriginY, mOriginZ;
+    };
+} /* Stealth::Noise */
+
+#endif /* end of include guard: NOISE_WINDOW_H */
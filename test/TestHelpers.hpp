@@ -0,0 +1,92 @@
+#ifndef NOISE_TEST_HELPERS_H
+#define NOISE_TEST_HELPERS_H
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+// Helpers shared by the tests and benchmarks. Every test and benchmark is a single source file, so this header may
+// define the replacement global new and delete, which cannot be inline.
+
+// Number of failed checks. Tests return it from main.
+inline int numFailures = 0;
+
+inline void check(bool condition, const char* description) {
+    if (!condition) {
+        std::cerr << "FAILED: " << description << std::endl;
+        ++numFailures;
+    }
+}
+
+// Whether the first size floats of a and b are the same bit for bit.
+template <typename A, typename B>
+bool identical(const A& a, const B& b, size_t size) {
+    return std::memcmp(a.data(), b.data(), size * sizeof(float)) == 0;
+}
+
+// Count every heap allocation made by the process. Every form of new and delete is replaced, so allocations are
+// always released by the matching function.
+inline std::atomic<long> numHeapAllocations{0};
+
+// Allocation and release are kept out of line so that GCC never sees malloc paired with operator delete, or
+// operator new paired with free, and warns about a mismatch.
+[[gnu::noinline]] void* operator new(std::size_t size) {
+    ++numHeapAllocations;
+    if (void* ptr = std::malloc(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+
+[[gnu::noinline]] void* operator new(std::size_t size, std::align_val_t alignment) {
+    ++numHeapAllocations;
+    const std::size_t align = static_cast<std::size_t>(alignment);
+    if (void* ptr = std::aligned_alloc(align, (size + align - 1) / align * align)) {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+[[gnu::noinline]] void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept {
+    operator delete(ptr);
+}
+
+#endif /* end of include guard: NOISE_TEST_HELPERS_H */
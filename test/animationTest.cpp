@@ -0,0 +1,157 @@
+#include "interfaces/NoiseGenerator"
+#include "TestHelpers.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+constexpr int WIDTH = 61;
+constexpr int LENGTH = 47;
+constexpr int HEIGHT = 13;
+constexpr int TIME_SCALE = 64;
+
+// Lattice points in time get twice as close in every octave, down to 2 frames apart.
+int nextTimeScale(int scaleT) {
+    return scaleT > 2 ? (scaleT + 1) / 2 : scaleT;
+}
+
+float maxDifference(const std::vector<float>& a, const std::vector<float>& b) {
+    float difference = 0.0f;
+    for (size_t i = 0; i < a.size(); ++i) {
+        difference = std::max(difference, std::abs(a[i] - b[i]));
+    }
+    return difference;
+}
+
+int main() {
+    const std::normal_distribution<float> distribution{0.5f, 0.3f};
+    const Stealth::Noise::NoiseEngine engine{WIDTH, LENGTH, HEIGHT, 40, 30, 13, 5};
+    Stealth::Noise::NoiseWorkspace workspace{};
+    std::vector<float> expected(engine.size()), actual(engine.size()), previous(engine.size());
+
+    // Frame 0 is the still map.
+    Stealth::Noise::NoiseTimeCache cache{};
+    engine.generateChunk(expected, workspace, -1, 2, 3, distribution, 7);
+    engine.generateChunkFrame(actual, cache, workspace, 0, TIME_SCALE, -1, 2, 3, distribution, 7);
+    check(identical(expected, actual, engine.size()), "Frame 0 matches generateChunk");
+
+    // Playing forward draws two slices per octave, then one more per octave each time it crosses a lattice point.
+    const long initialDraws = cache.slicesDrawn();
+    check(initialDraws == 2 * engine.numOctaves(), "The first frame draws two slices per octave");
+    long expectedDraws = initialDraws;
+    float maxStep = 0.0f;
+    bool cachedFramesMatch = true;
+    for (int frame = 1; frame <= 2 * TIME_SCALE; ++frame) {
+        previous = actual;
+        engine.generateChunkFrame(actual, cache, workspace, frame, TIME_SCALE, -1, 2, 3, distribution, 7, 3);
+        for (int i = 0, scaleT = TIME_SCALE; i < engine.numOctaves(); ++i, scaleT = nextTimeScale(scaleT)) {
+            expectedDraws += (frame % scaleT == 0);
+        }
+        maxStep = std::max(maxStep, maxDifference(actual, previous));
+        // A fresh cache draws everything again and must agree.
+        Stealth::Noise::NoiseTimeCache freshCache{};
+        engine.generateChunkFrame(expected, freshCache, workspace, frame, TIME_SCALE, -1, 2, 3, distribution, 7);
+        cachedFramesMatch &= identical(expected, actual, engine.size());
+    }
+    check(cache.slicesDrawn() == expectedDraws, "Frames only draw slices at lattice points in time");
+    check(cachedFramesMatch, "Cached slices give the same frames as fresh ones");
+
+    // Motion is smooth: consecutive frames are much closer than two unrelated maps.
+    engine.generateChunk(expected, workspace, -1, 2, 3, distribution, 8);
+    engine.generateChunk(previous, workspace, -1, 2, 3, distribution, 7);
+    check(maxStep < 0.25f * maxDifference(expected, previous), "Consecutive frames change smoothly");
+
+    // Playing backwards and jumping around reuse or redraw slices correctly.
+    bool reorderedFramesMatch = true;
+    for (int frame : {127, 126, 65, 64, 63, -1, -150, 400, 401}) {
+        engine.generateChunkFrame(actual, cache, workspace, frame, TIME_SCALE, -1, 2, 3, distribution, 7);
+        Stealth::Noise::NoiseTimeCache freshCache{};
+        engine.generateChunkFrame(expected, freshCache, workspace, frame, TIME_SCALE, -1, 2, 3, distribution, 7);
+        reorderedFramesMatch &= identical(expected, actual, engine.size());
+    }
+    check(reorderedFramesMatch, "Frames do not depend on the order they are played in");
+
+    // Octaves past the point where time lattice points are 2 frames apart keep that spacing, so odd frames of a deep
+    // stack draw nothing.
+    const Stealth::Noise::NoiseEngine deep{WIDTH, LENGTH, HEIGHT, 40, 30, 13, 10};
+    Stealth::Noise::NoiseTimeCache deepCache{};
+    bool deepDrawsMatch = true;
+    for (int frame = 0; frame <= 8; ++frame) {
+        const long drawn = deepCache.slicesDrawn();
+        deep.generateChunkFrame(actual, deepCache, workspace, frame, TIME_SCALE, 0, 0, 0, distribution, 7);
+        long expectedDeepDraws = 0;
+        for (int i = 0, scaleT = TIME_SCALE; i < deep.numOctaves(); ++i, scaleT = nextTimeScale(scaleT)) {
+            expectedDeepDraws += frame == 0 ? 2 : (frame % scaleT == 0);
+        }
+        deepDrawsMatch &= deepCache.slicesDrawn() - drawn == expectedDeepDraws;
+    }
+    check(deepDrawsMatch, "Deep octaves are not redrawn every frame");
+
+    // With one octave, frames between two lattice points blend the maps of the slices around them.
+    const Stealth::Noise::NoiseEngine single{WIDTH, LENGTH, HEIGHT, 40, 30, 13, 1};
+    std::vector<float> before(single.size()), after(single.size());
+    single.generateChunk(before, workspace, 1, 0, 0, distribution, 7);
+    single.generateChunk(after, workspace, 1, 0, 0, distribution, Stealth::Noise::timeSliceSeed(7, 1));
+    float maxBlendError = 0.0f;
+    for (int frame = 0; frame < TIME_SCALE; ++frame) {
+        single.generateChunkFrame(actual, cache, workspace, frame, TIME_SCALE, 1, 0, 0, distribution, 7);
+        const float t = frame / (float) TIME_SCALE;
+        const float weight = 6 * std::pow(t, 5) - 15 * std::pow(t, 4) + 10 * std::pow(t, 3);
+        for (size_t i = 0; i < before.size(); ++i) {
+            maxBlendError = std::max(maxBlendError, std::abs(before[i] + weight * (after[i] - before[i]) - actual[i]));
+        }
+    }
+    check(maxBlendError < 1e-5f, "Frames blend the lattice slices around them");
+
+    // 2D maps animate the same way, and the cache is reused without allocating.
+    const Stealth::Noise::NoiseEngine engine2D{WIDTH, LENGTH, 1, 16, 8, 1, 4};
+    engine2D.generateOctaves(expected, workspace, distribution, 3);
+    engine2D.generateFrame(actual, cache, workspace, 0, TIME_SCALE, distribution, 3);
+    check(identical(expected, actual, engine2D.size()), "2D frame 0 matches generateOctaves");
+    const long allocations = workspace.allocations();
+    for (int frame = 1; frame < 3 * TIME_SCALE; ++frame) {
+        engine2D.generateFrame(actual, cache, workspace, frame, TIME_SCALE, distribution, 3);
+    }
+    check(workspace.allocations() == allocations, "Frames reuse the workspace");
+
+    // Caches start over for another engine, even at the same address, or another distribution, and keep their slices
+    // for a copy of the same engine.
+    std::optional<Stealth::Noise::NoiseEngine> reused{std::in_place, WIDTH, LENGTH, 1, 16, 8, 1, 4};
+    reused->generateFrame(actual, cache, workspace, 5, TIME_SCALE, distribution, 3);
+    reused.emplace(WIDTH, LENGTH, 1, 32, 8, 1, 4);
+    reused->generateFrame(actual, cache, workspace, 5, TIME_SCALE, distribution, 3);
+    Stealth::Noise::NoiseTimeCache freshCache{};
+    reused->generateFrame(expected, freshCache, workspace, 5, TIME_SCALE, distribution, 3);
+    check(identical(expected, actual, reused->size()), "Time caches notice a new engine");
+    const std::normal_distribution<float> otherDistribution{0.2f, 0.1f};
+    reused->generateFrame(actual, cache, workspace, 5, TIME_SCALE, otherDistribution, 3);
+    reused->generateFrame(expected, freshCache, workspace, 5, TIME_SCALE, otherDistribution, 3);
+    check(identical(expected, actual, reused->size()), "Time caches notice a new distribution");
+    const Stealth::Noise::NoiseEngine copy{*reused};
+    const long slicesDrawn = cache.slicesDrawn();
+    copy.generateFrame(actual, cache, workspace, 6, TIME_SCALE, otherDistribution, 3);
+    check(cache.slicesDrawn() == slicesDrawn, "Time caches keep their slices for copies of the engine");
+
+    // Time scales below 1 are rejected before they reach the lattice arithmetic.
+    bool rejectsTimeScale = true;
+    for (const int timeScale : {0, -4}) {
+        try {
+            copy.generateFrame(actual, cache, workspace, 6, timeScale, distribution, 3);
+            rejectsTimeScale = false;
+        } catch (const std::invalid_argument&) {
+        }
+        try {
+            copy.generateChunkFrame(actual, cache, workspace, 6, timeScale, 1, 0, 0, distribution, 3);
+            rejectsTimeScale = false;
+        } catch (const std::invalid_argument&) {
+        }
+    }
+    check(rejectsTimeScale, "Time scales below 1 are rejected");
+
+    if (numFailures == 0) {
+        std::cout << "All animation tests passed." << std::endl;
+    }
+    return numFailures;
+}
@@ -0,0 +1,127 @@
+#include "interfaces/NoiseGenerator"
+#include "TestHelpers.hpp"
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+// Encode values in one call, so that the vectorized paths cover all but the tail.
+template <typename Encoder>
+std::vector<typename Encoder::value_type> encode(const Encoder& encoder, const std::vector<float>& values) {
+    std::vector<typename Encoder::value_type> output(values.size());
+    encoder(values.data(), values.size(), output.data());
+    return output;
+}
+
+float fromBits(uint32_t bits) {
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Every value between low and high in count steps, plus values on either side of the range and NaNs.
+std::vector<float> sweep(float low, float high, int count) {
+    std::vector<float> values{low - 1.0f, high + 1.0f, -std::numeric_limits<float>::infinity(),
+        std::numeric_limits<float>::infinity(), std::numeric_limits<float>::quiet_NaN(), fromBits(0xFFC00001u)};
+    for (int i = 0; i < count; ++i) {
+        values.emplace_back(low + (high - low) * i / (count - 1));
+    }
+    return values;
+}
+
+// Same clamping and rounding as the scalar tail of UnormEncoder.
+template <typename OutputType>
+std::vector<OutputType> expectedUnorm(const std::vector<float>& values, float low, float high) {
+    constexpr float maxValue = std::numeric_limits<OutputType>::max();
+    const float scale = maxValue / (high - low);
+    std::vector<OutputType> output;
+    for (float value : values) {
+        const float scaled = (value - low) * scale;
+        output.emplace_back(static_cast<OutputType>(((scaled > 0.0f) ? std::min(scaled, maxValue) : 0.0f) + 0.5f));
+    }
+    return output;
+}
+
+int main() {
+    using Stealth::Noise::HalfEncoder;
+    using Stealth::Noise::PaletteEncoder;
+    using Stealth::Noise::RGBA;
+    using Stealth::Noise::UnormEncoder;
+
+    // Unorm encoders cover the whole range of their type, clamp values outside [low, high], and vectorized lanes
+    // match the scalar tail.
+    const std::vector<float> unormValues = sweep(-0.5f, 1.5f, 1001);
+    check(encode(UnormEncoder<uint8_t>{-0.5f, 1.5f}, unormValues) == expectedUnorm<uint8_t>(unormValues, -0.5f, 1.5f),
+        "8-bit unorm lanes match the scalar path");
+    check(encode(UnormEncoder<uint16_t>{-0.5f, 1.5f}, unormValues)
+        == expectedUnorm<uint16_t>(unormValues, -0.5f, 1.5f), "16-bit unorm lanes match the scalar path");
+    check(encode(UnormEncoder<uint16_t>{}, {0.0f, 0.5f, 1.0f, -1.0f, 2.0f})
+        == std::vector<uint16_t>{0, 32768, 65535, 0, 65535}, "16-bit unorm covers and clamps to its range");
+    check(encode(UnormEncoder<uint8_t>{}, {0.0f, 0.5f, 1.0f, -1.0f, 2.0f})
+        == std::vector<uint8_t>{0, 128, 255, 0, 255}, "8-bit unorm covers and clamps to its range");
+    check(encode(UnormEncoder<uint16_t>{}, {std::numeric_limits<float>::quiet_NaN(), fromBits(0xFFC00001u)})
+        == std::vector<uint16_t>{0, 0}, "NaN encodes to 0");
+
+    // Halves round to nearest even, keep signed zeros, flush to subnormals and overflow to infinity.
+    check(HalfEncoder::toHalf(0.0f) == 0x0000 && HalfEncoder::toHalf(-0.0f) == 0x8000, "Signed zeros are kept");
+    check(HalfEncoder::toHalf(1.0f) == 0x3C00 && HalfEncoder::toHalf(-2.0f) == 0xC000
+        && HalfEncoder::toHalf(65504.0f) == 0x7BFF, "Normal halves are exact");
+    check(HalfEncoder::toHalf(1.0f + 0x1p-11f) == 0x3C00 && HalfEncoder::toHalf(1.0f + 0x3p-11f) == 0x3C02,
+        "Ties round to even");
+    check(HalfEncoder::toHalf(0x1p-14f) == 0x0400 && HalfEncoder::toHalf(0x1p-24f) == 0x0001
+        && HalfEncoder::toHalf(0x3FFp-24f) == 0x03FF && HalfEncoder::toHalf(-0x1p-24f) == 0x8001,
+        "Subnormal halves are exact");
+    check(HalfEncoder::toHalf(0x1p-25f) == 0x0000 && HalfEncoder::toHalf(0x3p-26f) == 0x0001
+        && HalfEncoder::toHalf(0x1p-30f) == 0x0000 && HalfEncoder::toHalf(-0x1p-30f) == 0x8000,
+        "Values below the smallest subnormal round to it or to zero");
+    check(HalfEncoder::toHalf(0x3FFp-25f) == 0x0200 && HalfEncoder::toHalf(0x7FFp-25f) == 0x0400,
+        "Subnormal halves round to even and carry into the next exponent");
+    check(HalfEncoder::toHalf(65519.0f) == 0x7BFF && HalfEncoder::toHalf(65520.0f) == 0x7C00
+        && HalfEncoder::toHalf(1e10f) == 0x7C00 && HalfEncoder::toHalf(-1e10f) == 0xFC00, "Overflow gives infinity");
+    check(HalfEncoder::toHalf(std::numeric_limits<float>::infinity()) == 0x7C00
+        && HalfEncoder::toHalf(-std::numeric_limits<float>::infinity()) == 0xFC00, "Infinities are kept");
+    const uint16_t nan = HalfEncoder::toHalf(std::numeric_limits<float>::quiet_NaN());
+    const uint16_t negativeNaN = HalfEncoder::toHalf(fromBits(0xFF800001u));
+    check((nan & 0x7C00) == 0x7C00 && (nan & 0x3FF) != 0 && (negativeNaN & 0xFC00) == 0xFC00
+        && (negativeNaN & 0x3FF) != 0, "NaNs stay NaNs, even when their payload does not fit");
+
+    // Vectorized halves match the scalar conversion for every kind of value.
+    std::vector<float> halfValues = sweep(-70000.0f, 70000.0f, 1001);
+    for (int exponent = -27; exponent <= 16; ++exponent) {
+        for (float mantissa : {1.0f, 1.0009765625f, 1.00048828125f, 1.5f, 1.99951171875f}) {
+            halfValues.emplace_back(std::ldexp(mantissa, exponent));
+            halfValues.emplace_back(-std::ldexp(mantissa, exponent));
+        }
+    }
+    halfValues.insert(halfValues.end(), {0.0f, -0.0f, std::numeric_limits<float>::quiet_NaN()});
+    std::vector<uint16_t> expectedHalves;
+    for (float value : halfValues) {
+        expectedHalves.emplace_back(HalfEncoder::toHalf(value));
+    }
+    check(encode(HalfEncoder{}, halfValues) == expectedHalves, "Half lanes match the scalar path");
+
+    // Palettes pick the nearest of their colors, spread evenly over [low, high], and clamp values outside.
+    const PaletteEncoder palette{{{0, 0, 0, 255}, {100, 0, 0, 255}, {200, 0, 0, 255}}, -1.0f, 1.0f};
+    std::vector<uint8_t> reds;
+    for (RGBA color : encode(palette, {-2.0f, -1.0f, -0.49f, -0.5f, 0.0f, 0.49f, 1.0f, 3.0f})) {
+        reds.emplace_back(color.r);
+    }
+    check(reds == std::vector<uint8_t>{0, 0, 100, 100, 100, 100, 200, 200}, "Palettes pick the nearest color");
+    const std::vector<RGBA> nanColors = encode(palette, {std::numeric_limits<float>::quiet_NaN(),
+        fromBits(0xFFC00001u)});
+    check(nanColors[0].r == 0 && nanColors[1].r == 0, "NaN picks the first color");
+    const PaletteEncoder single{{{1, 2, 3, 4}}};
+    const RGBA singleColor = encode(single, {-1.0f, 0.5f, 2.0f})[1];
+    check(singleColor.r == 1 && singleColor.g == 2 && singleColor.b == 3 && singleColor.a == 4,
+        "Single color palettes map everything to that color");
+    const PaletteEncoder gradient = PaletteEncoder::gradient({0, 0, 0, 0}, {255, 128, 64, 255}, 5);
+    check(gradient.colors.size() == 5 && gradient.colors[2].r == 128 && gradient.colors[2].g == 64
+        && gradient.colors[2].b == 32 && gradient.colors[4].r == 255 && gradient.colors[4].a == 255,
+        "Gradient palettes blend linearly between their ends");
+
+    if (numFailures == 0) {
+        std::cout << "All encoder tests passed." << std::endl;
+    }
+    return numFailures;
+}
@@ -0,0 +1,78 @@
+#include "interfaces/NoiseGenerator"
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <SFML/Window.hpp>
+#include <SFML/Graphics.hpp>
+#include <functional>
+#include <iostream>
+
+// Showcase of the runtime engine: a 2D map animated through time and coloured by a PaletteEncoder.
+
+constexpr int WINDOW_X = 500;
+constexpr int WINDOW_Y = 500;
+constexpr int FRAMERATE = 24;
+// Frames between lattice points in time for the first octave.
+constexpr int TIME_SCALE = 2 * FRAMERATE;
+
+const Stealth::Noise::PaletteEncoder noisePalette{Stealth::Noise::PaletteEncoder::gradient({0, 0, 0, 255},
+    {255, 255, 255, 255})};
+
+sf::Sprite spriteFromColorMap(const Stealth::Noise::RGBA* colors, int width, int length, sf::Texture& texture) {
+    sf::Image im;
+    sf::Sprite sprite;
+    im.create(width, length, (const uint8_t*) colors);
+    texture.loadFromImage(im);
+    sprite.setTexture(texture);
+    return sprite;
+}
+
+int main() {
+    // Window
+    sf::RenderWindow window(sf::VideoMode(WINDOW_X, WINDOW_Y), "Noise Engine Demo");
+
+    long long totalTime = 0;
+    int frame = 0;
+
+    // The map moves through time: each frame reuses the lattice time slices of the last one.
+    const Stealth::Noise::NoiseEngine engine{WINDOW_X, WINDOW_Y, 1, WINDOW_X, WINDOW_Y, 1, 8};
+    Stealth::Noise::NoiseWorkspace workspace{};
+    Stealth::Noise::NoiseTimeCache timeCache{};
+    std::vector<float> noiseMap(engine.size());
+    std::vector<Stealth::Noise::RGBA> colorMap(engine.size());
+
+    sf::Texture noiseTexture;
+    while (window.isOpen()) {
+        auto start = std::chrono::steady_clock::now();
+        engine.generateFrame(noiseMap, timeCache, workspace, frame, TIME_SCALE, std::normal_distribution{0.5f, 0.3f},
+            0, (int) std::thread::hardware_concurrency());
+        auto end = std::chrono::steady_clock::now();
+        totalTime += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        std::cout << "Average Frame Time:  " << (totalTime / ++frame / 1000.0) << " milliseconds" << '\r'
+            << std::flush;
+
+        noisePalette(noiseMap.data(), colorMap.size(), colorMap.data());
+        sf::Sprite noiseSprite = spriteFromColorMap(colorMap.data(), WINDOW_X, WINDOW_Y, noiseTexture);
+        // Draw
+        window.draw(noiseSprite);
+        // Display.
+        window.display();
+        // Handle events.
+        sf::Event event;
+        while (window.pollEvent(event)) {
+            if(event.type == sf::Event::Closed) {
+                window.close();
+            }
+        }
+        if constexpr (FRAMERATE > 0)
+        {
+            std::this_thread::sleep_for(
+                std::chrono::milliseconds(
+                    (long) 1000.0f / FRAMERATE
+                )
+            );
+
+        }
+    }
+    std::cout << std::endl;
+}
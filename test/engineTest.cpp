@@ -0,0 +1,239 @@
+#include "interfaces/NoiseGenerator"
+#include "TestHelpers.hpp"
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+constexpr int WIDTH = 61;
+constexpr int LENGTH = 47;
+constexpr int HEIGHT = 13;
+
+// Generate a flat map with generateOctavesFused, as chunk 0 and with a NoiseEngine, and compare them all with
+// generateOctaves. The templates generate such maps as 2D or 1D maps over the remaining axes.
+template <int width, int length, int height>
+bool matchesOctaves() {
+    Stealth::Tensor::Tensor3F<width, length, height> expected{}, fused{}, chunk{};
+    Stealth::Noise::generateOctaves<width, length, height, 5, 4, 3, 3>(expected,
+        std::normal_distribution{0.5f, 0.3f}, 7);
+    Stealth::Noise::generateOctavesFused<width, length, height, 5, 4, 3, 3>(fused,
+        std::normal_distribution{0.5f, 0.3f}, 7);
+    Stealth::Noise::generateChunk<width, length, height, 5, 4, 3, 3>(chunk, 0, 0, 0,
+        std::normal_distribution{0.5f, 0.3f}, 7);
+    const Stealth::Noise::NoiseEngine engine{width, length, height, 5, 4, 3, 3};
+    std::vector<float> actual(engine.size());
+    engine.generateOctaves(actual, std::normal_distribution{0.5f, 0.3f}, 7);
+    return identical(expected, fused, width * length * height) && identical(expected, chunk, width * length * height)
+        && identical(expected, actual, engine.size());
+}
+
+template <int width, int length>
+bool matchesOctaves() {
+    Stealth::Tensor::Tensor3F<width, length> expected{}, fused{}, chunk{};
+    Stealth::Noise::generateOctaves<width, length, 5, 4, 3>(expected, std::normal_distribution{0.5f, 0.3f}, 7);
+    Stealth::Noise::generateOctavesFused<width, length, 5, 4, 3>(fused, std::normal_distribution{0.5f, 0.3f}, 7);
+    Stealth::Noise::generateChunk<width, length, 5, 4, 3>(chunk, 0, 0, std::normal_distribution{0.5f, 0.3f}, 7);
+    const Stealth::Noise::NoiseEngine engine{width, length, 1, 5, 4, 1, 3};
+    std::vector<float> actual(engine.size());
+    engine.generateOctaves(actual, std::normal_distribution{0.5f, 0.3f}, 7);
+    return identical(expected, fused, width * length) && identical(expected, chunk, width * length)
+        && identical(expected, actual, engine.size());
+}
+
+// Generate chunk (chunkX, chunkY, chunkZ) of a flat map with generateChunk and with a NoiseEngine, and compare them.
+template <int width, int length, int height>
+bool matchesChunk(int chunkX, int chunkY, int chunkZ) {
+    Stealth::Tensor::Tensor3F<width, length, height> expected{};
+    Stealth::Noise::generateChunk<width, length, height, 5, 4, 3, 3>(expected, chunkX, chunkY, chunkZ,
+        std::normal_distribution{0.5f, 0.3f}, 7);
+    const Stealth::Noise::NoiseEngine engine{width, length, height, 5, 4, 3, 3};
+    std::vector<float> actual(engine.size());
+    engine.generateChunk(actual, chunkX, chunkY, chunkZ, std::normal_distribution{0.5f, 0.3f}, 7);
+    return identical(expected, actual, engine.size());
+}
+
+int main() {
+    // The runtime engine must reproduce the templates exactly.
+    Stealth::Tensor::Tensor3F<WIDTH, LENGTH, HEIGHT> expected{};
+    Stealth::Noise::generateOctaves<WIDTH, LENGTH, HEIGHT, 40, 30, 13, 5>(expected,
+        std::normal_distribution{0.5f, 0.3f}, 7);
+    const Stealth::Noise::NoiseEngine engine{WIDTH, LENGTH, HEIGHT, 40, 30, 13, 5};
+    std::vector<float> actual(engine.size());
+    engine.generateOctaves(actual, std::normal_distribution{0.5f, 0.3f}, 7, 3);
+    check(identical(expected, actual, engine.size()), "NoiseEngine matches generateOctaves");
+
+    Stealth::Noise::generateChunk<WIDTH, LENGTH, HEIGHT, 40, 30, 13, 5>(expected, -1, 2, 3,
+        std::normal_distribution{0.5f, 0.3f}, 7);
+    engine.generateChunk(actual, -1, 2, 3, std::normal_distribution{0.5f, 0.3f}, 7);
+    check(identical(expected, actual, engine.size()), "NoiseEngine matches generateChunk");
+
+    // Fused generation and chunk 0 match generateOctaves for flat maps too.
+    check(matchesOctaves<23, 1, 11>() && matchesOctaves<1, 23, 11>() && matchesOctaves<1, 1, 23>()
+        && matchesOctaves<23, 11, 1>() && matchesOctaves<1, 23, 1>(),
+        "generateOctavesFused and generateChunk match generateOctaves for flat 3D maps");
+    check(matchesOctaves<1, 23>() && matchesOctaves<23, 1>(),
+        "generateOctavesFused and generateChunk match generateOctaves for flat 2D maps");
+    check(matchesOctaves<8, 1, 8>() && matchesOctaves<1, 8, 8>() && matchesOctaves<1, 8, 1>()
+        && matchesOctaves<1, 1, 1>(), "NoiseEngine matches generateOctaves for flat maps");
+    check(matchesChunk<23, 1, 11>(-1, 0, 2) && matchesChunk<1, 23, 11>(3, -1, 1) && matchesChunk<23, 11, 1>(2, 1, 0),
+        "NoiseEngine matches generateChunk for flat maps");
+
+    // Flat axes are interpolated, so flat chunks stacked along them are the layers of a thicker map.
+    const Stealth::Noise::NoiseEngine layerEngine{23, 11, 1, 5, 4, 3, 3};
+    const Stealth::Noise::NoiseEngine volumeEngine{23, 11, 7, 5, 4, 3, 3};
+    std::vector<float> layer(layerEngine.size()), volume(volumeEngine.size());
+    volumeEngine.generateChunk(volume, 1, -2, 1, std::normal_distribution{0.5f, 0.3f}, 7);
+    bool layersMatch = true;
+    for (int z = 0; z < 7; ++z) {
+        layerEngine.generateChunk(layer, 1, -2, 7 + z, std::normal_distribution{0.5f, 0.3f}, 7);
+        layersMatch &= std::memcmp(layer.data(), volume.data() + z * layerEngine.size(),
+            layerEngine.size() * sizeof(float)) == 0;
+    }
+    check(layersMatch, "Flat chunks are the layers of a thicker map");
+
+    // Sizes, scales and octave counts must be positive.
+    bool rejectsEmptyMaps = false;
+    try {
+        const Stealth::Noise::NoiseEngine emptyEngine{0, 8, 8, 5, 4, 3, 3};
+    } catch (const std::invalid_argument&) {
+        rejectsEmptyMaps = true;
+    }
+    check(rejectsEmptyMaps, "NoiseEngine rejects empty maps");
+
+    // Chunks whose elements lie beyond the range of int still line up with their neighbours.
+    constexpr int farChunk = 2000000000;
+    Stealth::Tensor::Tensor3F<46, 9, 5> farPair{};
+    Stealth::Tensor::Tensor3F<23, 9, 5> farLeft{}, farRight{};
+    Stealth::Noise::generateChunk<46, 9, 5, 5, 4, 3, 3>(farPair, farChunk / 2, -3, 1,
+        std::normal_distribution{0.5f, 0.3f}, 7);
+    Stealth::Noise::generateChunk<23, 9, 5, 5, 4, 3, 3>(farLeft, farChunk, -3, 1,
+        std::normal_distribution{0.5f, 0.3f}, 7);
+    Stealth::Noise::generateChunk<23, 9, 5, 5, 4, 3, 3>(farRight, farChunk + 1, -3, 1,
+        std::normal_distribution{0.5f, 0.3f}, 7);
+    bool farChunksMatch = true;
+    for (int row = 0; row < 9 * 5; ++row) {
+        farChunksMatch &= std::memcmp(farPair.data() + row * 46, farLeft.data() + row * 23, 23 * sizeof(float)) == 0
+            && std::memcmp(farPair.data() + row * 46 + 23, farRight.data() + row * 23, 23 * sizeof(float)) == 0;
+    }
+    check(farChunksMatch, "Distant chunks line up with their neighbours");
+
+    // The engine computes distant origins the same way, in every path.
+    const Stealth::Noise::NoiseEngine farEngine{23, 9, 5, 5, 4, 3, 3};
+    std::vector<float> farActual(farEngine.size());
+    farEngine.generateChunk(farActual, farChunk, -3, 1, std::normal_distribution{0.5f, 0.3f}, 7);
+    bool farEngineMatches = identical(farLeft, farActual, farEngine.size());
+    farEngine.generateChunk(farActual, farChunk + 1, -3, 1, std::normal_distribution{0.5f, 0.3f}, 7);
+    farEngineMatches &= identical(farRight, farActual, farEngine.size());
+    check(farEngineMatches, "NoiseEngine::generateChunk matches generateChunk for distant chunks");
+
+    const long farSeeds[] = {7, 7};
+    std::vector<float> farBatch[2] = {std::vector<float>(farEngine.size()), std::vector<float>(farEngine.size())};
+    Stealth::Noise::NoiseWorkspace farWorkspace{};
+    farEngine.generateChunkBatch(farBatch, farSeeds, 2, farWorkspace, farChunk, -3, 1,
+        std::normal_distribution{0.5f, 0.3f});
+    check(identical(farLeft, farBatch[0], farEngine.size()) && identical(farLeft, farBatch[1], farEngine.size()),
+        "NoiseEngine::generateChunkBatch matches generateChunk for distant chunks");
+
+    std::vector<int64_t> farX, farY, farZ;
+    for (int i = 0; i < farEngine.size(); ++i) {
+        farX.push_back(static_cast<int64_t>(farChunk) * 23 + i % 23);
+        farY.push_back(-3 * 9 + (i / 23) % 9);
+        farZ.push_back(5 + i / (23 * 9));
+    }
+    farEngine.sample(farX.data(), farY.data(), farZ.data(), farEngine.size(), farActual.data(),
+        std::normal_distribution{0.5f, 0.3f}, 7);
+    check(identical(farLeft, farActual, farEngine.size()), "NoiseEngine::sample matches distant chunks");
+
+    // Point queries must reproduce the dense chunk they fall in.
+    std::vector<int> queryX, queryY, queryZ;
+    std::vector<float> denseValues;
+    for (int i = 0; i < 500; ++i) {
+        const int x = (i * 7) % WIDTH, y = (i * 13) % LENGTH, z = (i * 5) % HEIGHT;
+        queryX.push_back(x - WIDTH);
+        queryY.push_back(y + 2 * LENGTH);
+        queryZ.push_back(z + 3 * HEIGHT);
+        denseValues.push_back(actual[x + y * WIDTH + z * WIDTH * LENGTH]);
+    }
+    std::vector<float> sampledValues(denseValues.size());
+    engine.sample(queryX.data(), queryY.data(), queryZ.data(), sampledValues.size(), sampledValues.data(),
+        std::normal_distribution{0.5f, 0.3f}, 7);
+    check(identical(denseValues, sampledValues, sampledValues.size()), "NoiseEngine::sample matches dense maps");
+
+    // Encoded output must match encoding the float map afterwards.
+    std::vector<uint8_t> encoded(engine.size()), expectedEncoded(engine.size());
+    const Stealth::Noise::UnormEncoder<uint8_t> encoder{0.0f, 1.0f};
+    engine.generateChunkEncoded(encoded, encoder, -1, 2, 3, std::normal_distribution{0.5f, 0.3f}, 7, 3);
+    encoder(actual.data(), actual.size(), expectedEncoded.data());
+    check(encoded == expectedEncoded, "NoiseEngine::generateChunkEncoded matches encoding generateChunk");
+
+    // After the first call, a workspace makes generation allocation-free.
+    Stealth::Noise::NoiseWorkspace workspace{};
+    engine.generateOctavesEncoded(encoded, workspace, encoder, std::normal_distribution{0.5f, 0.3f}, 0);
+    check(workspace.allocations() == 1, "Workspace allocates once on first use");
+    const long heapAllocationsBefore = numHeapAllocations;
+    for (long seed = 1; seed < 8; ++seed) {
+        engine.generateOctaves(actual, workspace, std::normal_distribution{0.5f, 0.3f}, seed);
+        engine.generateChunk(actual, workspace, seed, -seed, 0, Stealth::Noise::DefaultDistribution{0.f, 1.f}, seed);
+        engine.generateOctavesEncoded(encoded, workspace, encoder, std::normal_distribution{0.5f, 0.3f}, seed);
+    }
+    check(workspace.allocations() == 1, "Workspace does not grow in steady state");
+    check(numHeapAllocations == heapAllocationsBefore, "Steady-state generation does not allocate");
+
+    // Worker threads persist between calls, so multithreaded generation does not allocate in steady state either.
+    engine.generateChunk(actual, workspace, 0, 0, 0, Stealth::Noise::DefaultDistribution{0.f, 1.f}, 0, 4);
+    const long threadedAllocationsBefore = numHeapAllocations;
+    for (long seed = 1; seed < 8; ++seed) {
+        engine.generateChunk(actual, workspace, seed, -seed, 0, Stealth::Noise::DefaultDistribution{0.f, 1.f}, seed, 4);
+    }
+    check(numHeapAllocations == threadedAllocationsBefore, "Multithreaded steady-state generation does not allocate");
+
+    // 1D maps are split across threads too, without changing the result.
+    Stealth::Tensor::Tensor3F<1000> line{}, threadedLine{};
+    Stealth::Noise::generateOctaves<1000, 64, 5>(line, std::normal_distribution{0.5f, 0.3f}, 7);
+    Stealth::Noise::generateOctaves<1000, 64, 5>(threadedLine, std::normal_distribution{0.5f, 0.3f}, 7, 0.5f, 4);
+    check(identical(line, threadedLine, 1000), "Multithreaded 1D generation is identical");
+
+    // Batched maps must match generating each map on its own.
+    const long batchSeeds[] = {7, 8, -3};
+    const std::normal_distribution<float> batchDistributions[] = {std::normal_distribution{0.5f, 0.3f},
+        std::normal_distribution{0.0f, 1.0f}, std::normal_distribution{2.0f, 0.1f}};
+    std::vector<float> batchMaps[3] = {std::vector<float>(engine.size()), std::vector<float>(engine.size()),
+        std::vector<float>(engine.size())};
+    Stealth::Noise::NoiseWorkspace batchWorkspace{};
+    engine.generateChunkBatch(batchMaps, batchSeeds, batchDistributions, 3, batchWorkspace, -1, 2, 3, 3);
+    bool batchMatches = true;
+    for (int map = 0; map < 3; ++map) {
+        engine.generateChunk(actual, -1, 2, 3, batchDistributions[map], batchSeeds[map]);
+        batchMatches &= identical(batchMaps[map], actual, engine.size());
+    }
+    check(batchMatches, "NoiseEngine::generateChunkBatch matches generateChunk");
+
+    const Stealth::Noise::NoiseEngine engine2D{WIDTH, LENGTH, 1, 16, 8, 1, 4};
+    engine2D.generateOctavesBatch(batchMaps, batchSeeds, 3, batchWorkspace, std::normal_distribution{0.5f, 0.3f});
+    batchMatches = true;
+    for (int map = 0; map < 3; ++map) {
+        engine2D.generateOctaves(actual, std::normal_distribution{0.5f, 0.3f}, batchSeeds[map]);
+        batchMatches &= identical(batchMaps[map], actual, engine2D.size());
+    }
+    check(batchMatches, "NoiseEngine::generateOctavesBatch matches generateOctaves in 2D");
+
+    // Maps are the lanes of the batched kernels, so 13 maps use every vector width and the scalar tail.
+    std::vector<long> manySeeds(13);
+    std::vector<std::vector<float>> manyMaps(manySeeds.size(), std::vector<float>(engine.size()));
+    for (size_t map = 0; map < manySeeds.size(); ++map) {
+        manySeeds[map] = 100 + map;
+    }
+    engine.generateChunkBatch(manyMaps.data(), manySeeds.data(), manySeeds.size(), batchWorkspace, 2, -1, 0,
+        std::normal_distribution{0.5f, 0.3f}, 2);
+    batchMatches = true;
+    for (size_t map = 0; map < manySeeds.size(); ++map) {
+        engine.generateChunk(actual, 2, -1, 0, std::normal_distribution{0.5f, 0.3f}, manySeeds[map]);
+        batchMatches &= identical(manyMaps[map], actual, engine.size());
+    }
+    check(batchMatches, "NoiseEngine::generateChunkBatch matches generateChunk for every lane");
+
+    if (numFailures == 0) {
+        std::cout << "All engine tests passed." << std::endl;
+    }
+    return numFailures;
+}
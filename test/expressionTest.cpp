@@ -0,0 +1,140 @@
+#include "interfaces/NoiseGenerator"
+#include "TestHelpers.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+constexpr int WIDTH = 61;
+constexpr int LENGTH = 47;
+constexpr int HEIGHT = 13;
+
+// True if expression[i] == func(i) for every element.
+template <typename Function>
+bool matches(const std::vector<float>& expression, Function&& func) {
+    for (size_t i = 0; i < expression.size(); ++i) {
+        if (expression[i] != func(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main() {
+    using namespace Stealth::Noise;
+    const std::normal_distribution<float> distribution{0.5f, 0.3f};
+    const NoiseEngine engine{WIDTH, LENGTH, HEIGHT, 40, 30, 13, 5};
+    std::vector<float> first(engine.size()), second(engine.size()), actual(engine.size());
+    engine.generateOctaves(first, distribution, 7);
+    engine.generateOctaves(second, distribution, 8);
+
+    // Fields reproduce the engine exactly, including chunk offsets.
+    const NoiseExpression a = NoiseExpression::field(engine, distribution, 7);
+    const NoiseExpression b = NoiseExpression::field(engine, distribution, 8);
+    a.evaluate(actual, WIDTH, LENGTH, HEIGHT);
+    check(identical(first, actual, engine.size()), "Fields match generateOctaves");
+    std::vector<float> chunk(engine.size());
+    engine.generateChunk(chunk, -1, 2, 3, distribution, 7);
+    a.evaluate(actual, WIDTH, LENGTH, HEIGHT, -WIDTH, 2 * LENGTH, 3 * HEIGHT);
+    check(identical(chunk, actual, engine.size()), "Fields match generateChunk");
+
+    // Boxes larger than the engine's shape are generated in pieces.
+    std::vector<float> wide(4 * WIDTH * LENGTH * HEIGHT);
+    a.evaluate(wide, 2 * WIDTH, 2 * LENGTH, HEIGHT, -WIDTH, 2 * LENGTH, 3 * HEIGHT);
+    bool widePiecesMatch = true;
+    for (int z = 0; z < HEIGHT; ++z) {
+        for (int y = 0; y < LENGTH; ++y) {
+            widePiecesMatch &= std::memcmp(wide.data() + y * 2 * WIDTH + z * 4 * WIDTH * LENGTH,
+                chunk.data() + y * WIDTH + z * WIDTH * LENGTH, WIDTH * sizeof(float)) == 0;
+        }
+    }
+    check(widePiecesMatch, "Fields larger than the engine match generateChunk");
+
+    // Arithmetic is applied elementwise.
+    (a + b * 2.0f).evaluate(actual, WIDTH, LENGTH, HEIGHT);
+    check(matches(actual, [&](size_t i) { return first[i] + second[i] * 2.0f; }), "Arithmetic matches");
+    (a - b / 4.0f).evaluate(actual, WIDTH, LENGTH, HEIGHT);
+    check(matches(actual, [&](size_t i) { return first[i] - second[i] / 4.0f; }), "Subtraction matches");
+    (min(a, b) + max(a, b)).evaluate(actual, WIDTH, LENGTH, HEIGHT);
+    check(matches(actual, [&](size_t i) { return std::min(first[i], second[i]) + std::max(first[i], second[i]); }),
+        "min and max match");
+    // Numbers only become constants next to an expression.
+    static_assert(!std::is_convertible_v<float, NoiseExpression>, "Numbers must not convert to expressions");
+    (1.0f - max(0.5f, a) / 2).evaluate(actual, WIDTH, LENGTH, HEIGHT);
+    check(matches(actual, [&](size_t i) { return 1.0f - std::max(0.5f, first[i]) / 2.0f; }),
+        "Numbers work on either side");
+    clamp(abs(a - 0.5f), 0.1f, 0.2f).evaluate(actual, WIDTH, LENGTH, HEIGHT);
+    check(matches(actual, [&](size_t i) { return std::min(std::max(std::abs(first[i] - 0.5f), 0.1f), 0.2f); }),
+        "clamp and abs match");
+    ridge(a).evaluate(actual, WIDTH, LENGTH, HEIGHT);
+    check(matches(actual, [&](size_t i) { return 1.0f - 2.0f * std::abs(first[i] - 0.5f); }), "ridge matches");
+
+    // Multithreaded evaluation is identical.
+    const NoiseExpression combined = ridge(a) * b + clamp(a, 0.0f, 1.0f);
+    std::vector<float> parallel(engine.size());
+    combined.evaluate(actual, WIDTH, LENGTH, HEIGHT);
+    combined.evaluate(parallel, WIDTH, LENGTH, HEIGHT, 0, 0, 0, 4);
+    check(identical(actual, parallel, engine.size()), "Multithreaded evaluation is identical");
+
+    // Maps from the template generators can be used as leaves.
+    Stealth::Tensor::Tensor3F<WIDTH, LENGTH, HEIGHT> generated{};
+    generateOctaves<WIDTH, LENGTH, HEIGHT, 40, 30, 13, 5>(generated, distribution, 7);
+    (NoiseExpression::map(generated, WIDTH, LENGTH, HEIGHT) - a).evaluate(actual, WIDTH, LENGTH, HEIGHT);
+    check(matches(actual, [](size_t) { return 0.0f; }), "Template maps work as leaves");
+
+    // Zero offsets leave the source unchanged and constant offsets shift it.
+    warp(a, NoiseExpression{0.0f}, NoiseExpression{0.0f}, NoiseExpression{0.0f}, 8.0f).evaluate(actual, WIDTH,
+        LENGTH, HEIGHT);
+    check(identical(first, actual, engine.size()), "Warping by zero is the identity");
+    warp(a, NoiseExpression{0.5f}, NoiseExpression{-0.25f}, NoiseExpression{0.125f}, 8.0f).evaluate(actual, WIDTH, LENGTH, HEIGHT, -WIDTH - 4, 2 * LENGTH + 2,
+        3 * HEIGHT - 1);
+    check(identical(chunk, actual, engine.size()), "Warping by a constant shifts the source");
+    // Warped elements interpolate the source between the elements around the moved positions, first along y,
+    // then along x.
+    const NoiseExpression warped = warp(a, b - 0.5f, a - 0.5f, 16.0f);
+    warped.evaluate(actual, WIDTH, LENGTH, HEIGHT);
+    std::vector<int> x(engine.size()), y(engine.size()), z(engine.size());
+    std::vector<float> fractionX(engine.size()), fractionY(engine.size());
+    for (int i = 0; i < engine.size(); ++i) {
+        const float displacementX = 16.0f * (second[i] - 0.5f), displacementY = 16.0f * (first[i] - 0.5f);
+        x[i] = i % WIDTH + static_cast<int>(std::floor(displacementX));
+        y[i] = i / WIDTH % LENGTH + static_cast<int>(std::floor(displacementY));
+        z[i] = i / (WIDTH * LENGTH);
+        fractionX[i] = displacementX - std::floor(displacementX);
+        fractionY[i] = displacementY - std::floor(displacementY);
+    }
+    std::vector<float> corners[2][2];
+    for (int dx = 0; dx < 2; ++dx) {
+        for (int dy = 0; dy < 2; ++dy) {
+            std::vector<int> cornerX(x), cornerY(y);
+            for (int i = 0; i < engine.size(); ++i) {
+                cornerX[i] += dx;
+                cornerY[i] += dy;
+            }
+            corners[dx][dy].resize(engine.size());
+            engine.sample(cornerX.data(), cornerY.data(), z.data(), engine.size(), corners[dx][dy].data(),
+                distribution, 7);
+        }
+    }
+    check(matches(actual, [&](size_t i) {
+        const float low = corners[0][0][i] + fractionY[i] * (corners[0][1][i] - corners[0][0][i]);
+        const float high = corners[1][0][i] + fractionY[i] * (corners[1][1][i] - corners[1][0][i]);
+        return low + fractionX[i] * (high - low);
+    }), "Warped elements interpolate point queries");
+    warped.evaluate(parallel, WIDTH, LENGTH, HEIGHT, 0, 0, 0, 3);
+    check(identical(actual, parallel, engine.size()), "Multithreaded warps are identical");
+
+    // 2D engines work the same way.
+    const NoiseEngine engine2D{WIDTH, LENGTH, 1, 16, 8, 1, 4};
+    engine2D.generateOctaves(first, distribution, 3);
+    (NoiseExpression::field(engine2D, distribution, 3) * 3.0f).evaluate(actual, WIDTH, LENGTH);
+    check(matches(std::vector<float>(actual.begin(), actual.begin() + engine2D.size()),
+        [&](size_t i) { return first[i] * 3.0f; }), "2D fields match generateOctaves");
+
+    if (numFailures == 0) {
+        std::cout << "All expression tests passed." << std::endl;
+    }
+    return numFailures;
+}
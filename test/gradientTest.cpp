@@ -0,0 +1,87 @@
+#include "interfaces/NoiseGenerator"
+#include "TestHelpers.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+constexpr int WIDTH = 61;
+constexpr int LENGTH = 47;
+constexpr int HEIGHT = 23;
+
+// Largest difference between a gradient and central differences of the map, relative to the largest derivative.
+// Only interior elements have both neighbours.
+float centralDifferenceError(const std::vector<float>& map, const std::vector<float>& gradient, int step,
+    int width, int length, int height) {
+    float maxError = 0.0f, maxDerivative = 0.0f;
+    for (int z = 0; z < height; ++z) {
+        for (int y = 0; y < length; ++y) {
+            for (int x = 0; x < width; ++x) {
+                const int index = x + y * width + z * width * length;
+                const int coordinate = (step == 1) ? x : (step == width) ? y : z;
+                const int size = (step == 1) ? width : (step == width) ? length : height;
+                if (coordinate == 0 || coordinate == size - 1) {
+                    continue;
+                }
+                const float difference = (map[index + step] - map[index - step]) / 2.0f;
+                maxError = std::max(maxError, std::abs(difference - gradient[index]));
+                maxDerivative = std::max(maxDerivative, std::abs(gradient[index]));
+            }
+        }
+    }
+    return maxError / maxDerivative;
+}
+
+int main() {
+    const std::normal_distribution<float> distribution{0.5f, 0.3f};
+    Stealth::Noise::NoiseWorkspace workspace{};
+    std::vector<float> expected(WIDTH * LENGTH * HEIGHT), actual(expected.size()), gradientX(expected.size()),
+        gradientY(expected.size()), gradientZ(expected.size());
+
+    // Values must not change, and large scales keep central differences close to the true derivatives.
+    const Stealth::Noise::NoiseEngine engine{WIDTH, LENGTH, HEIGHT, 40, 30, 20, 2};
+    engine.generateChunk(expected, workspace, -1, 2, 3, distribution, 7);
+    engine.generateChunkGradient(actual, gradientX, gradientY, gradientZ, workspace, -1, 2, 3, distribution, 7, 3);
+    check(identical(expected, actual, engine.size()), "Gradient maps keep the values of generateChunk");
+    check(centralDifferenceError(actual, gradientX, 1, WIDTH, LENGTH, HEIGHT) < 0.05f, "x derivatives match");
+    check(centralDifferenceError(actual, gradientY, WIDTH, WIDTH, LENGTH, HEIGHT) < 0.05f, "y derivatives match");
+    check(centralDifferenceError(actual, gradientZ, WIDTH * LENGTH, WIDTH, LENGTH, HEIGHT) < 0.05f,
+        "z derivatives match");
+
+    // Octaves accumulate exactly like the values do.
+    const Stealth::Noise::NoiseEngine octaveEngine{WIDTH, LENGTH, HEIGHT, 40, 30, 20, 5};
+    octaveEngine.generateOctaves(expected, workspace, distribution, 11);
+    octaveEngine.generateOctavesGradient(actual, gradientX, gradientY, gradientZ, workspace, distribution, 11);
+    check(identical(expected, actual, octaveEngine.size()), "Octave gradient maps keep the values");
+    std::vector<float> singleX(expected.size()), singleY(expected.size()), singleZ(expected.size());
+    std::vector<float> expectedX(expected.size(), 0.0f);
+    float total = 0.0f;
+    for (int i = 0; i < octaveEngine.numOctaves(); ++i) {
+        const Stealth::Noise::NoiseEngine::Octave& octave = octaveEngine.octaves()[i];
+        const Stealth::Noise::NoiseEngine single{WIDTH, LENGTH, HEIGHT, octave.scaleX, octave.scaleY, octave.scaleZ, 1};
+        single.generateOctavesGradient(actual, singleX, singleY, singleZ, workspace, distribution,
+            Stealth::Noise::octaveSeed(11, i));
+        for (size_t j = 0; j < expectedX.size(); ++j) {
+            expectedX[j] += singleX[j] * octave.multiplier;
+        }
+        total += octave.multiplier;
+    }
+    float maxError = 0.0f;
+    for (size_t j = 0; j < expectedX.size(); ++j) {
+        maxError = std::max(maxError, std::abs(expectedX[j] / total - gradientX[j]));
+    }
+    check(maxError < 1e-5f, "Octave gradients are the weighted sum of each octave's gradient");
+
+    // 2D maps only have x and y derivatives.
+    const Stealth::Noise::NoiseEngine engine2D{WIDTH, LENGTH, 1, 60, 48, 1, 2};
+    engine2D.generateOctaves(expected, workspace, distribution, 3);
+    engine2D.generateOctavesGradient(actual, gradientX, gradientY, workspace, distribution, 3);
+    check(identical(expected, actual, engine2D.size()), "2D gradient maps keep the values");
+    check(centralDifferenceError(actual, gradientX, 1, WIDTH, LENGTH, 1) < 0.05f, "2D x derivatives match");
+    check(centralDifferenceError(actual, gradientY, WIDTH, WIDTH, LENGTH, 1) < 0.05f, "2D y derivatives match");
+
+    if (numFailures == 0) {
+        std::cout << "All gradient tests passed." << std::endl;
+    }
+    return numFailures;
+}
@@ -0,0 +1,108 @@
+#define NOISE_GENERATOR_INSTRUMENTATION
+#include "interfaces/NoiseGenerator"
+#include "TestHelpers.hpp"
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+constexpr int WIDTH = 61;
+constexpr int LENGTH = 47;
+constexpr int HEIGHT = 13;
+constexpr int NUM_OCTAVES = 5;
+
+// Totals per phase and octave, keyed by (phase, octave).
+using Totals = std::map<std::tuple<Stealth::Noise::Phase, int>, Stealth::Noise::PhaseRecord>;
+
+static std::mutex totalsMutex;
+static Totals totals;
+// Whether every record so far had the scales of its octave.
+static bool octavesMatchScales = true;
+
+// Every octave must have interpolated the whole map once, and the map must have been normalized once.
+void checkTotals(const Stealth::Noise::NoiseEngine& engine, const char* description) {
+    long voxelsInterpolated = 0, voxelsNormalized = 0, latticePoints = 0;
+    int numInterpolatedOctaves = 0;
+    for (const auto& [key, record] : totals) {
+        if (record.phase == Stealth::Noise::Phase::Interpolation) {
+            ++numInterpolatedOctaves;
+            voxelsInterpolated += record.voxels;
+        } else if (record.phase == Stealth::Noise::Phase::Normalization) {
+            voxelsNormalized += record.voxels;
+        }
+        latticePoints += record.latticePoints;
+    }
+    check(numInterpolatedOctaves == NUM_OCTAVES && voxelsInterpolated == (long) NUM_OCTAVES * engine.size()
+        && voxelsNormalized == engine.size() && latticePoints > 0, description);
+    totals.clear();
+}
+
+int main() {
+    const Stealth::Noise::NoiseEngine engine{WIDTH, LENGTH, HEIGHT, 40, 30, 13, NUM_OCTAVES};
+    // Scales from 4 reach 1 after 2 octaves, so the last 3 octaves share their scales.
+    const Stealth::Noise::NoiseEngine saturated{WIDTH, LENGTH, HEIGHT, 4, 4, 4, NUM_OCTAVES};
+    const Stealth::Noise::NoiseEngine* current = &engine;
+    Stealth::Noise::setInstrumentationSink([&](const Stealth::Noise::PhaseRecord& record) {
+        std::lock_guard<std::mutex> lock{totalsMutex};
+        if (record.octave == -1) {
+            octavesMatchScales &= record.phase == Stealth::Noise::Phase::Normalization && record.scaleX == 0;
+        } else {
+            const auto& octave = current->octaves().at(record.octave);
+            octavesMatchScales &= record.scaleX == octave.scaleX && record.scaleY == octave.scaleY
+                && record.scaleZ == octave.scaleZ;
+        }
+        auto& total = totals[{record.phase, record.octave}];
+        total.phase = record.phase;
+        total.nanoseconds += record.nanoseconds;
+        total.voxels += record.voxels;
+        total.latticePoints += record.latticePoints;
+    });
+    Stealth::Tensor::Tensor3F<WIDTH, LENGTH, HEIGHT> expected{};
+    Stealth::Noise::generateOctaves<WIDTH, LENGTH, HEIGHT, 40, 30, 13, NUM_OCTAVES>(expected,
+        std::normal_distribution{0.5f, 0.3f}, 7, 0.5f, 3);
+    checkTotals(engine, "generateOctaves reports every phase");
+
+    Stealth::Tensor::Tensor3F<WIDTH, LENGTH, HEIGHT> fused{};
+    Stealth::Noise::generateOctavesFused<WIDTH, LENGTH, HEIGHT, 40, 30, 13, NUM_OCTAVES>(fused,
+        std::normal_distribution{0.5f, 0.3f}, 7, 0.5f, 3);
+    checkTotals(engine, "generateOctavesFused reports every phase");
+
+    std::vector<float> actual(engine.size());
+    engine.generateOctaves(actual, std::normal_distribution{0.5f, 0.3f}, 7, 3);
+    // Chunk 0 starts on a lattice point, so it overlaps ceilDivide(size, scale) + 1 points of every axis.
+    long latticePoints = 0;
+    for (const auto& octave : engine.octaves()) {
+        latticePoints += static_cast<long>(Stealth::Noise::ceilDivide(WIDTH, octave.scaleX) + 1)
+            * (Stealth::Noise::ceilDivide(LENGTH, octave.scaleY) + 1)
+            * (Stealth::Noise::ceilDivide(HEIGHT, octave.scaleZ) + 1);
+    }
+    long reportedLatticePoints = 0;
+    for (const auto& [key, record] : totals) {
+        reportedLatticePoints += record.latticePoints;
+    }
+    check(reportedLatticePoints == latticePoints, "NoiseEngine reports every lattice point it draws");
+    checkTotals(engine, "NoiseEngine reports every phase");
+
+    // Instrumentation must not change the output.
+    check(std::memcmp(expected.data(), actual.data(), engine.size() * sizeof(float)) == 0
+        && std::memcmp(fused.data(), actual.data(), engine.size() * sizeof(float)) == 0,
+        "Instrumented generators still match");
+
+    // Octaves are told apart even once their scales stop shrinking.
+    current = &saturated;
+    saturated.generateOctaves(actual, std::normal_distribution{0.5f, 0.3f}, 7);
+    checkTotals(saturated, "Octaves with the same scales are reported separately");
+    check(octavesMatchScales, "Records report the octave their scales belong to");
+
+    // An empty sink turns reporting off.
+    Stealth::Noise::setInstrumentationSink({});
+    engine.generateOctaves(actual, std::normal_distribution{0.5f, 0.3f}, 7);
+    check(totals.empty(), "Empty sink disables reporting");
+
+    if (numFailures == 0) {
+        std::cout << "All instrumentation tests passed." << std::endl;
+    }
+    return numFailures;
+}
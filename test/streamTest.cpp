@@ -0,0 +1,79 @@
+#include "interfaces/NoiseGenerator"
+#include "TestHelpers.hpp"
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <vector>
+
+constexpr int WIDTH = 61;
+constexpr int LENGTH = 47;
+constexpr int HEIGHT = 13;
+
+// Consume a whole stream and check that it reproduces the dense map in order.
+template <typename Stream>
+bool matchesDense(Stream& stream, const std::vector<float>& expected, int area, int height) {
+    typename Stream::Slab slab;
+    int nextZ = 0;
+    bool matches = true;
+    while (stream.next(slab)) {
+        matches &= slab.beginZ == nextZ && slab.endZ > slab.beginZ && slab.endZ <= height
+            && std::memcmp(slab.values, expected.data() + slab.beginZ * area,
+            (slab.endZ - slab.beginZ) * area * sizeof(float)) == 0;
+        nextZ = slab.endZ;
+    }
+    return matches && nextZ == height;
+}
+
+int main() {
+    using Stream = Stealth::Noise::NoiseStream<std::normal_distribution<float>>;
+    const std::normal_distribution<float> distribution{0.5f, 0.3f};
+    const Stealth::Noise::NoiseEngine engine{WIDTH, LENGTH, HEIGHT, 40, 30, 13, 5};
+    std::vector<float> expected(engine.size());
+    engine.generateOctaves(expected, distribution, 7);
+
+    for (int slabDepth : {1, 2, 5, 13, 20}) {
+        Stream stream{engine, distribution, 7, slabDepth, 2, 2};
+        check(matchesDense(stream, expected, WIDTH * LENGTH, HEIGHT), "Slabs match generateOctaves");
+    }
+
+    // Small scales make every slab cross several lattice layers.
+    const Stealth::Noise::NoiseEngine fineEngine{WIDTH, LENGTH, HEIGHT, 7, 5, 3, 3};
+    fineEngine.generateOctaves(expected, distribution, 11);
+    Stream fineStream{fineEngine, distribution, 11, 4, 1};
+    check(matchesDense(fineStream, expected, WIDTH * LENGTH, HEIGHT), "Slabs match generateOctaves at small scales");
+
+    // 2D maps are a single slab.
+    const Stealth::Noise::NoiseEngine engine2D{WIDTH, LENGTH, 1, 40, 30, 1, 5};
+    engine2D.generateOctaves(expected, distribution, 3);
+    Stream stream2D{engine2D, distribution, 3};
+    check(matchesDense(stream2D, expected, WIDTH * LENGTH, 1), "2D stream matches generateOctaves");
+
+    // Layer caches start over for another engine, even at the same address, or another distribution.
+    const int area = WIDTH * LENGTH;
+    std::optional<Stealth::Noise::NoiseEngine> reused{std::in_place, WIDTH, LENGTH, HEIGHT, 40, 30, 13, 5};
+    Stealth::Noise::NoiseLayerCache cache{};
+    std::vector<float> layers(4 * area);
+    reused->generateLayers(layers.data(), cache, 0, 4, distribution, 7);
+    reused.emplace(WIDTH, LENGTH, HEIGHT, 7, 5, 3, 5);
+    reused->generateOctaves(expected, distribution, 7);
+    reused->generateLayers(layers.data(), cache, 2, 6, distribution, 7);
+    check(std::memcmp(layers.data(), expected.data() + 2 * area, 4 * area * sizeof(float)) == 0,
+        "Layer caches notice a new engine");
+    const std::normal_distribution<float> otherDistribution{0.2f, 0.1f};
+    reused->generateOctaves(expected, otherDistribution, 7);
+    reused->generateLayers(layers.data(), cache, 4, 8, otherDistribution, 7);
+    check(std::memcmp(layers.data(), expected.data() + 4 * area, 4 * area * sizeof(float)) == 0,
+        "Layer caches notice a new distribution");
+
+    // Streams can be abandoned early.
+    {
+        Stream stream{engine, distribution, 7, 1, 1};
+        Stream::Slab slab;
+        check(stream.next(slab) && slab.beginZ == 0, "Abandoned stream produces its first slab");
+    }
+
+    if (numFailures == 0) {
+        std::cout << "All stream tests passed." << std::endl;
+    }
+    return numFailures;
+}
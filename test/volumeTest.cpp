@@ -0,0 +1,175 @@
+#include "interfaces/NoiseGenerator"
+#include "TestHelpers.hpp"
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+constexpr int WIDTH = 61;
+constexpr int LENGTH = 47;
+constexpr int HEIGHT = 13;
+
+// Invalid volumes never match, rather than being read through a null mapping.
+template <typename B>
+bool identical(const Stealth::Noise::NoiseVolume& volume, const B& b, size_t size) {
+    return volume && volume.size() == size && std::memcmp(volume.data(), b.data(), size * sizeof(float)) == 0;
+}
+
+int main() {
+    char directoryTemplate[] = "/tmp/noiseVolumeTestXXXXXX";
+    const std::string directory = ::mkdtemp(directoryTemplate);
+    const std::normal_distribution<float> distribution{0.5f, 0.3f};
+    const Stealth::Noise::NoiseEngine engine{WIDTH, LENGTH, HEIGHT, 40, 30, 13, 5};
+    std::vector<float> expected(engine.size());
+    engine.generateOctaves(expected, distribution, 7);
+
+    // Volumes hold exactly what generateOctaves produces, and survive being reopened.
+    const std::string path = directory + "/volume.noise";
+    {
+        Stealth::Noise::NoiseVolume volume = Stealth::Noise::generateVolume(path, engine, distribution, 7);
+        check(volume && volume.size() == expected.size() && identical(volume, expected, expected.size()),
+            "Generated volume matches generateOctaves");
+    }
+    Stealth::Noise::NoiseVolume reopened = Stealth::Noise::NoiseVolume::open(path);
+    check(reopened && identical(reopened, expected, expected.size()), "Reopened volume matches generateOctaves");
+    check(reopened && reopened.header().width == WIDTH && reopened.header().numOctaves == 5
+        && reopened.header().seed == 7 && std::strncmp(reopened.header().distribution, "normal", 6) == 0, "Header describes the volume");
+
+    // Opened volumes are copy-on-write.
+    reopened.data()[0] = -1.0f;
+    const Stealth::Noise::NoiseVolume untouched = Stealth::Noise::NoiseVolume::open(path);
+    check(untouched && untouched.data()[0] == expected[0], "Writes to opened volumes stay private");
+
+    // Volumes can be used as generation targets directly.
+    engine.generateOctaves(reopened, distribution, 8);
+    engine.generateOctaves(expected, distribution, 8);
+    check(identical(reopened, expected, expected.size()), "Volumes work as generation targets");
+
+    // Files that are not complete volumes are rejected.
+    std::ofstream{directory + "/truncated.noise"} << "STNOISE";
+    check(!Stealth::Noise::NoiseVolume::open(directory + "/truncated.noise"), "Truncated files are rejected");
+    check(!Stealth::Noise::NoiseVolume::open(directory + "/missing.noise"), "Missing files are rejected");
+    const Stealth::Noise::NoiseVolume missing = Stealth::Noise::NoiseVolume::open(directory + "/missing.noise");
+    check(missing.data() == nullptr && missing.size() == 0, "Invalid volumes are empty");
+
+    // Files written on a machine of the other byte order are rejected.
+    {
+        std::fstream file{path, std::ios::in | std::ios::out | std::ios::binary};
+        const uint32_t swapped = 0x04030201;
+        file.seekp(offsetof(Stealth::Noise::NoiseVolumeHeader, byteOrder));
+        file.write(reinterpret_cast<const char*>(&swapped), sizeof(swapped));
+    }
+    check(!Stealth::Noise::NoiseVolume::open(path), "Files of the other byte order are rejected");
+
+    // Dimensions whose size overflows to the size of the file are rejected.
+    {
+        Stealth::Noise::NoiseVolumeHeader header = Stealth::Noise::noiseVolumeHeader(engine, distribution, 7);
+        header.width = header.length = 1 << 30;
+        header.height = 16;
+        std::vector<char> file(header.dataOffset);
+        std::memcpy(file.data(), &header, sizeof(header));
+        std::ofstream{directory + "/overflow.noise", std::ios::binary}.write(file.data(), file.size());
+    }
+    check(!Stealth::Noise::NoiseVolume::open(directory + "/overflow.noise"), "Overflowing dimensions are rejected");
+
+    // Large volumes are generated in several slabs.
+    const Stealth::Noise::NoiseEngine largeEngine{2048, 2048, 6, 37, 19, 3, 3};
+    std::vector<float> largeExpected(largeEngine.size());
+    largeEngine.generateOctaves(largeExpected, distribution, 5);
+    check(identical(Stealth::Noise::generateVolume(directory + "/large.noise", largeEngine, distribution, 5),
+        largeExpected, largeExpected.size()), "Volumes generated in several slabs match generateOctaves");
+    std::remove((directory + "/large.noise").c_str());
+
+    // Volumes are grids of chunks, so they can be larger than any single engine.
+    {
+        constexpr int chunksX = 3, chunksY = 2, chunksZ = 2;
+        const std::string gridPath = directory + "/grid.noise";
+        const Stealth::Noise::NoiseVolume grid = Stealth::Noise::generateVolume(gridPath, engine, distribution, 7, 2,
+            chunksX, chunksY, chunksZ);
+        check(grid && grid.size() == static_cast<size_t>(engine.size()) * chunksX * chunksY * chunksZ
+            && grid.header().width == chunksX * WIDTH && grid.header().chunkWidth == WIDTH,
+            "Chunk grids set the shape of the volume");
+        const size_t rowStride = static_cast<size_t>(chunksX) * WIDTH;
+        const size_t layerStride = rowStride * chunksY * LENGTH;
+        std::vector<float> chunk(engine.size());
+        bool tilesMatch = static_cast<bool>(grid);
+        for (int chunkZ = 0; chunkZ < chunksZ && tilesMatch; ++chunkZ) {
+            for (int chunkY = 0; chunkY < chunksY; ++chunkY) {
+                for (int chunkX = 0; chunkX < chunksX; ++chunkX) {
+                    engine.generateChunk(chunk, chunkX, chunkY, chunkZ, distribution, 7);
+                    for (int z = 0; z < HEIGHT; ++z) {
+                        for (int y = 0; y < LENGTH; ++y) {
+                            const float* row = grid.data() + (chunkZ * HEIGHT + z) * layerStride
+                                + (chunkY * LENGTH + y) * rowStride + chunkX * WIDTH;
+                            tilesMatch &= std::memcmp(row, chunk.data() + (z * LENGTH + y) * WIDTH,
+                                WIDTH * sizeof(float)) == 0;
+                        }
+                    }
+                }
+            }
+        }
+        check(tilesMatch, "Every tile of a chunk grid matches generateChunk");
+        std::remove(gridPath.c_str());
+    }
+    // Sizes are 64-bit throughout, so volumes of more than 2^31 elements can be created and mapped. The file is
+    // sparse, so only the touched page uses the disk.
+    {
+        const std::string hugePath = directory + "/huge.noise";
+        const size_t hugeSize = static_cast<size_t>(engine.size()) * 250 * 250;
+        {
+            Stealth::Noise::NoiseVolume huge = Stealth::Noise::NoiseVolume::create(hugePath,
+                Stealth::Noise::noiseVolumeHeader(engine, distribution, 7, 250, 250, 1));
+            check(huge && huge.size() == hugeSize && hugeSize > (size_t{1} << 31), "Huge volumes can be created");
+            if (huge) {
+                huge.data()[hugeSize - 1] = 0.25f;
+            }
+        }
+        const Stealth::Noise::NoiseVolume huge = Stealth::Noise::NoiseVolume::open(hugePath);
+        check(huge && huge.size() == hugeSize && huge.data()[hugeSize - 1] == 0.25f, "Huge volumes can be reopened");
+        std::remove(hugePath.c_str());
+    }
+    bool rejectsGrid = true;
+    for (const int chunks : {0, -1, std::numeric_limits<int32_t>::max() / WIDTH + 1}) {
+        try {
+            Stealth::Noise::noiseVolumeHeader(engine, distribution, 7, chunks, 1, 1);
+            rejectsGrid = false;
+        } catch (const std::invalid_argument&) {
+        }
+    }
+    check(rejectsGrid, "Empty grids and sides of 2^31 elements are rejected");
+
+    // The cache generates each volume once and maps it afterwards.
+    const Stealth::Noise::NoiseVolumeCache cache{directory + "/cache"};
+    engine.generateOctaves(expected, distribution, 7);
+    check(!cache.contains(engine, distribution, 7), "Cache starts empty");
+    check(identical(cache.get(engine, distribution, 7), expected, expected.size()), "Cache miss generates the volume");
+    check(cache.contains(engine, distribution, 7), "Cache keeps generated volumes");
+    check(identical(cache.get(engine, distribution, 7), expected, expected.size()), "Cache hit maps the volume");
+    check(!cache.contains(engine, distribution, 8) && !cache.contains(engine, std::normal_distribution{0.5f, 0.4f}, 7)
+        && !cache.contains(Stealth::Noise::NoiseEngine{WIDTH, LENGTH, HEIGHT, 40, 30, 13, 5, 0.6f}, distribution, 7),
+        "Cache keys cover seed, distribution and parameters");
+    check(!cache.contains(engine, distribution, 7, 2, 1, 1), "Cache keys cover the chunk grid");
+
+    // Stale or damaged files are regenerated.
+    std::ofstream{cache.path(engine, distribution, 7), std::ios::trunc} << "garbage";
+    check(!cache.contains(engine, distribution, 7), "Damaged cache files do not match");
+    check(identical(cache.get(engine, distribution, 7), expected, expected.size()), "Damaged cache files are replaced");
+
+    std::remove(cache.path(engine, distribution, 7).c_str());
+    std::remove((directory + "/cache").c_str());
+    std::remove((directory + "/truncated.noise").c_str());
+    std::remove((directory + "/overflow.noise").c_str());
+    std::remove(path.c_str());
+    std::remove(directory.c_str());
+
+    if (numFailures == 0) {
+        std::cout << "All volume tests passed." << std::endl;
+    }
+    return numFailures;
+}
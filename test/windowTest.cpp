@@ -0,0 +1,75 @@
+#include "interfaces/NoiseGenerator"
+#include "TestHelpers.hpp"
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+constexpr int WIDTH = 61;
+constexpr int LENGTH = 47;
+constexpr int HEIGHT = 13;
+
+template <typename Window>
+std::vector<float> unrolled(const Window& window) {
+    std::vector<float> values(window.width() * window.length() * window.height());
+    window.copyTo(values);
+    return values;
+}
+
+int main() {
+    using Window = Stealth::Noise::NoiseWindow<std::normal_distribution<float>>;
+    const std::normal_distribution<float> distribution{0.5f, 0.3f};
+    const Stealth::Noise::NoiseEngine engine{WIDTH, LENGTH, HEIGHT, 40, 30, 13, 5};
+    std::vector<float> expected(engine.size());
+
+    // A window built on a chunk holds exactly that chunk.
+    Window window{WIDTH, LENGTH, HEIGHT, 40, 30, 13, 5, 0.5f, distribution, 7, 2};
+    engine.generateOctaves(expected, distribution, 7);
+    check(identical(expected, unrolled(window), engine.size()), "NoiseWindow matches generateOctaves");
+
+    // Scrolling in small steps, including across ring and lattice boundaries, must land on the dense chunk.
+    const int shifts[][3] = {{5, 0, 0}, {0, -7, 0}, {-12, 3, 1}, {29, 40, -4}, {1, 1, 1}, {60, -46, 12}};
+    for (const auto& shift : shifts) {
+        window.move(shift[0], shift[1], shift[2]);
+        const Window fresh{WIDTH, LENGTH, HEIGHT, 40, 30, 13, 5, 0.5f, distribution, 7, 1, window.originX(),
+            window.originY(), window.originZ()};
+        check(identical(unrolled(fresh), unrolled(window), engine.size()), "Scrolled window matches a new window");
+    }
+
+    // Columns exposed one at a time are interpolated by the scalar tail, but still match the vector lanes.
+    window.moveTo(-WIDTH - 11, 2 * LENGTH, HEIGHT);
+    for (int step = 0; step < 11; ++step) {
+        window.move(1, 0, 0);
+    }
+    engine.generateChunk(expected, -1, 2, 1, distribution, 7);
+    check(identical(expected, unrolled(window), engine.size()), "Window scrolled by single columns matches generateChunk");
+    window.moveTo(-WIDTH, 2 * LENGTH, HEIGHT);
+    check(identical(expected, unrolled(window), engine.size()), "Scrolled window matches generateChunk");
+    check(window(3, 4, 5) == expected[3 + 4 * WIDTH + 5 * WIDTH * LENGTH], "Window elements match generateChunk");
+
+    // Jumps larger than the window regenerate it.
+    window.move(3 * WIDTH, -LENGTH, 0);
+    engine.generateChunk(expected, 2, 1, 1, distribution, 7);
+    check(identical(expected, unrolled(window), engine.size()), "Jumping window matches generateChunk");
+
+    // Windows reach chunks whose elements lie beyond the range of int.
+    const int farChunk = 100000000;
+    window.moveTo(int64_t{farChunk} * WIDTH - 5, -LENGTH, 0);
+    window.move(5, 0, 0);
+    engine.generateChunk(expected, farChunk, -1, 0, distribution, 7);
+    check(identical(expected, unrolled(window), engine.size()), "Distant window matches generateChunk");
+
+    // 2D windows scroll too.
+    Window window2D{WIDTH, LENGTH, 1, 40, 30, 1, 5, 0.5f, distribution, 3};
+    const Stealth::Noise::NoiseEngine engine2D{WIDTH, LENGTH, 1, 40, 30, 1, 5};
+    for (int step = 0; step < 2 * WIDTH; step += 9) {
+        window2D.move(9, -2);
+    }
+    window2D.moveTo(WIDTH, -LENGTH, 0);
+    engine2D.generateChunk(expected, 1, -1, 0, distribution, 3);
+    check(identical(expected, unrolled(window2D), engine2D.size()), "Scrolled 2D window matches generateChunk");
+
+    if (numFailures == 0) {
+        std::cout << "All window tests passed." << std::endl;
+    }
+    return numFailures;
+}